@@ -21,4 +21,6 @@ enum class DocumentStatus
     REMOVED,
 };
 
+const size_t DOCUMENT_STATUS_COUNT = 4;
+
 std::ostream &operator<<(std::ostream &out, const Document &doc);
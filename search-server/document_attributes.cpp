@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <stdexcept>
+#include "document_attributes.h"
+
+DocumentAttributes::Ordinal DocumentAttributes::Add(int document_id, int rating, DocumentStatus status)
+{
+    if (ids_.size() >= NO_ORDINAL)
+        throw std::length_error("too many documents");
+
+    const Ordinal ordinal = static_cast<Ordinal>(ids_.size());
+    ids_.push_back(document_id);
+    ratings_.push_back(rating);
+    statuses_.push_back(static_cast<uint8_t>(status));
+    id_to_ordinal_.emplace(document_id, ordinal);
+    rating_tail_.push_back(ordinal);
+    if (rating_tail_.size() > std::max(MIN_SORTED_TAIL, by_rating_.size() / SORTED_TAIL_DIVISOR))
+    {
+        MergeRatingTail();
+    }
+    return ordinal;
+}
+
+void DocumentAttributes::Remove(Ordinal ordinal)
+{
+    if (!IsAlive(ordinal))
+        return;
+
+    id_to_ordinal_.erase(ids_[ordinal]);
+    statuses_[ordinal] = REMOVED_SLOT;
+}
+
+DocumentAttributes::Ordinal DocumentAttributes::FindOrdinal(int document_id) const
+{
+    const auto it = id_to_ordinal_.find(document_id);
+    return it == id_to_ordinal_.end() ? NO_ORDINAL : it->second;
+}
+
+size_t DocumentAttributes::CountRatingRange(int min_rating, int max_rating) const
+{
+    const auto [first, last] = EqualRatingRange(min_rating, max_rating);
+    return (last - first) + std::count_if(rating_tail_.begin(), rating_tail_.end(), [this, min_rating, max_rating](Ordinal ordinal)
+                                          { return min_rating <= ratings_[ordinal] && ratings_[ordinal] <= max_rating; });
+}
+
+void DocumentAttributes::FindRatingRange(int min_rating, int max_rating, std::vector<Ordinal> &out) const
+{
+    const auto [first, last] = EqualRatingRange(min_rating, max_rating);
+    for (auto it = first; it != last; ++it)
+    {
+        if (IsAlive(*it))
+        {
+            out.push_back(*it);
+        }
+    }
+    for (const Ordinal ordinal : rating_tail_)
+    {
+        if (IsAlive(ordinal) && min_rating <= ratings_[ordinal] && ratings_[ordinal] <= max_rating)
+        {
+            out.push_back(ordinal);
+        }
+    }
+}
+
+size_t DocumentAttributes::GetMemoryUsage() const
+{
+    // узел unordered_map: указатель на следующий узел, пара и закэшированный хэш
+    const size_t node_size = sizeof(void *) + sizeof(std::pair<const int, Ordinal>) + sizeof(size_t);
+    return ids_.capacity() * sizeof(int32_t) + ratings_.capacity() * sizeof(int32_t) + statuses_.capacity() * sizeof(uint8_t) +
+           id_to_ordinal_.bucket_count() * sizeof(void *) + id_to_ordinal_.size() * node_size +
+           (by_rating_.capacity() + rating_tail_.capacity()) * sizeof(Ordinal);
+}
+
+void DocumentAttributes::ReadBatch(std::span<const Ordinal> ordinals, std::span<int32_t> ratings, std::span<uint8_t> statuses) const
+{
+    if (!ratings.empty())
+    {
+        for (size_t i = 0; i < ordinals.size(); ++i)
+        {
+            ratings[i] = ratings_[ordinals[i]];
+        }
+    }
+    if (!statuses.empty())
+    {
+        for (size_t i = 0; i < ordinals.size(); ++i)
+        {
+            statuses[i] = statuses_[ordinals[i]];
+        }
+    }
+}
+
+std::pair<std::vector<DocumentAttributes::Ordinal>::const_iterator, std::vector<DocumentAttributes::Ordinal>::const_iterator>
+DocumentAttributes::EqualRatingRange(int min_rating, int max_rating) const
+{
+    if (min_rating > max_rating)
+    {
+        return {by_rating_.end(), by_rating_.end()};
+    }
+    const auto first = std::partition_point(by_rating_.begin(), by_rating_.end(), [this, min_rating](Ordinal ordinal)
+                                            { return ratings_[ordinal] < min_rating; });
+    const auto last = std::partition_point(first, by_rating_.end(), [this, max_rating](Ordinal ordinal)
+                                           { return ratings_[ordinal] <= max_rating; });
+    return {first, last};
+}
+
+void DocumentAttributes::MergeRatingTail()
+{
+    // удалённые документы не переносятся, поэтому отсортированная часть не растёт за счёт удалений
+    std::erase_if(by_rating_, [this](Ordinal ordinal)
+                  { return !IsAlive(ordinal); });
+    std::erase_if(rating_tail_, [this](Ordinal ordinal)
+                  { return !IsAlive(ordinal); });
+
+    const auto by_rating = [this](Ordinal lhs, Ordinal rhs)
+    {
+        return ratings_[lhs] < ratings_[rhs];
+    };
+    std::sort(rating_tail_.begin(), rating_tail_.end(), by_rating);
+    const size_t middle = by_rating_.size();
+    by_rating_.insert(by_rating_.end(), rating_tail_.begin(), rating_tail_.end());
+    std::inplace_merge(by_rating_.begin(), by_rating_.begin() + middle, by_rating_.end(), by_rating);
+    rating_tail_.clear();
+}
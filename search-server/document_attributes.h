@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "document.h"
+
+/// @brief Колоночное хранилище атрибутов документов.
+/// Рейтинги и статусы лежат в плотных массивах, индексируемых внутренним порядковым номером документа.
+/// Для фильтров по диапазону рейтингов порядковые номера хранятся ещё и по возрастанию рейтинга: как в словаре,
+/// новые документы копятся в коротком хвосте и вливаются в отсортированную часть, когда хвост вырастает до доли от неё
+class DocumentAttributes
+{
+public:
+    using Ordinal = uint32_t;
+
+    static constexpr Ordinal NO_ORDINAL = UINT32_MAX;
+    /// @brief Значение в колонке статусов для удалённого документа
+    static constexpr uint8_t REMOVED_SLOT = UINT8_MAX;
+    /// @brief Хвост вливается в отсортированную по рейтингу часть, когда превышает её долю 1/SORTED_TAIL_DIVISOR
+    static constexpr size_t SORTED_TAIL_DIVISOR = 8;
+    static constexpr size_t MIN_SORTED_TAIL = 64;
+
+    /// @brief Добавить документ, возвращает его порядковый номер
+    Ordinal Add(int document_id, int rating, DocumentStatus status);
+
+    /// @brief Пометить документ удалённым. Порядковые номера остальных документов не меняются
+    void Remove(Ordinal ordinal);
+
+    /// @brief Порядковый номер документа или NO_ORDINAL, если документа нет
+    Ordinal FindOrdinal(int document_id) const;
+
+    bool Contains(int document_id) const { return FindOrdinal(document_id) != NO_ORDINAL; }
+    bool IsAlive(Ordinal ordinal) const { return statuses_[ordinal] != REMOVED_SLOT; }
+
+    /// @brief Количество выданных порядковых номеров, включая удалённые документы
+    size_t GetOrdinalCount() const { return ids_.size(); }
+    size_t GetAliveCount() const { return id_to_ordinal_.size(); }
+
+    int GetId(Ordinal ordinal) const { return ids_[ordinal]; }
+    int GetRating(Ordinal ordinal) const { return ratings_[ordinal]; }
+    DocumentStatus GetStatus(Ordinal ordinal) const { return static_cast<DocumentStatus>(statuses_[ordinal]); }
+
+    /// @brief Пакетное чтение атрибутов по списку порядковых номеров
+    /// @param ordinals порядковые номера документов
+    /// @param ratings, statuses выходные буферы размером не меньше ordinals.size(), пустой буфер пропускается
+    void ReadBatch(std::span<const Ordinal> ordinals, std::span<int32_t> ratings, std::span<uint8_t> statuses) const;
+
+    std::span<const int32_t> GetIds() const { return ids_; }
+    std::span<const int32_t> GetRatings() const { return ratings_; }
+    std::span<const uint8_t> GetStatuses() const { return statuses_; }
+
+    /// @brief Верхняя оценка числа документов с рейтингом в [min_rating, max_rating]: удалённые документы, ещё не выброшенные из индекса, тоже учитываются
+    size_t CountRatingRange(int min_rating, int max_rating) const;
+
+    /// @brief Порядковые номера живых документов с рейтингом в [min_rating, max_rating] в out. Порядок не определён
+    void FindRatingRange(int min_rating, int max_rating, std::vector<Ordinal> &out) const;
+
+    /// @brief Приблизительный объём занятой динамической памяти
+    size_t GetMemoryUsage() const;
+
+private:
+    std::vector<int32_t> ids_;
+    std::vector<int32_t> ratings_;
+    std::vector<uint8_t> statuses_;
+    std::unordered_map<int, Ordinal> id_to_ordinal_;
+    std::vector<Ordinal> by_rating_;   // по возрастанию рейтинга, удалённые документы выбрасываются при слиянии
+    std::vector<Ordinal> rating_tail_; // новые документы, ещё не влитые в by_rating_
+
+    /// @brief Границы документов с рейтингом в [min_rating, max_rating] в отсортированной части
+    std::pair<std::vector<Ordinal>::const_iterator, std::vector<Ordinal>::const_iterator> EqualRatingRange(int min_rating, int max_rating) const;
+    void MergeRatingTail();
+};
@@ -0,0 +1,97 @@
+#include <bit>
+#include "document_filter.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define DOCUMENT_FILTER_SSE2
+#endif
+
+size_t CandidateBitmap::Count() const
+{
+    size_t result = 0;
+    for (const uint64_t word : words_)
+    {
+        result += std::popcount(word);
+    }
+    return result;
+}
+
+namespace filter
+{
+    // Циклы ниже без ветвлений и с фиксированным шагом, компилятор разворачивает их в векторные сравнения
+
+    void Status::EvaluateBlock(const DocumentAttributes &attributes, size_t first, size_t count, BlockHits &hits) const
+    {
+        const uint8_t *statuses = attributes.GetStatuses().data() + first;
+        const uint8_t expected = static_cast<uint8_t>(status);
+        for (size_t i = 0; i < count; ++i)
+        {
+            hits[i] = statuses[i] == expected ? 0xFF : 0;
+        }
+    }
+
+    void RatingAtLeast::EvaluateBlock(const DocumentAttributes &attributes, size_t first, size_t count, BlockHits &hits) const
+    {
+        const int32_t *ratings = attributes.GetRatings().data() + first;
+        for (size_t i = 0; i < count; ++i)
+        {
+            hits[i] = ratings[i] >= rating ? 0xFF : 0;
+        }
+    }
+
+    void RatingInRange::EvaluateBlock(const DocumentAttributes &attributes, size_t first_ordinal, size_t count, BlockHits &hits) const
+    {
+        const int32_t *ratings = attributes.GetRatings().data() + first_ordinal;
+        for (size_t i = 0; i < count; ++i)
+        {
+            hits[i] = (ratings[i] >= first) & (ratings[i] <= last) ? 0xFF : 0;
+        }
+    }
+
+    void IdInRange::EvaluateBlock(const DocumentAttributes &attributes, size_t first_ordinal, size_t count, BlockHits &hits) const
+    {
+        const int32_t *ids = attributes.GetIds().data() + first_ordinal;
+        for (size_t i = 0; i < count; ++i)
+        {
+            hits[i] = (ids[i] >= first) & (ids[i] <= last) ? 0xFF : 0;
+        }
+    }
+
+    void IdParity::EvaluateBlock(const DocumentAttributes &attributes, size_t first, size_t count, BlockHits &hits) const
+    {
+        const int32_t *ids = attributes.GetIds().data() + first;
+        const int32_t expected = even ? 0 : 1;
+        for (size_t i = 0; i < count; ++i)
+        {
+            hits[i] = (ids[i] & 1) == expected ? 0xFF : 0;
+        }
+    }
+
+    void EvaluateAlive(const DocumentAttributes &attributes, size_t first, size_t count, BlockHits &hits)
+    {
+        const uint8_t *statuses = attributes.GetStatuses().data() + first;
+        for (size_t i = 0; i < count; ++i)
+        {
+            hits[i] = statuses[i] != DocumentAttributes::REMOVED_SLOT ? 0xFF : 0;
+        }
+    }
+
+    uint64_t PackHits(const BlockHits &hits, size_t count)
+    {
+        uint64_t result = 0;
+#ifdef DOCUMENT_FILTER_SSE2
+        for (size_t i = 0; i < FILTER_BLOCK_SIZE; i += 16)
+        {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(hits.data() + i));
+            result |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(chunk))) << i;
+        }
+#else
+        for (size_t i = 0; i < FILTER_BLOCK_SIZE; ++i)
+        {
+            result |= static_cast<uint64_t>(hits[i] >> 7) << i;
+        }
+#endif
+        // хвост последнего блока не содержит документов
+        return count == FILTER_BLOCK_SIZE ? result : result & ((uint64_t{1} << count) - 1);
+    }
+}
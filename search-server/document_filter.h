@@ -0,0 +1,299 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+#include <vector>
+#include "document.h"
+#include "document_attributes.h"
+
+const size_t FILTER_BLOCK_SIZE = 64;
+
+/// @brief Битовая карта кандидатов: бит i установлен, если документ с порядковым номером i прошёл фильтр
+class CandidateBitmap
+{
+public:
+    using Ordinal = DocumentAttributes::Ordinal;
+
+    CandidateBitmap() = default;
+    explicit CandidateBitmap(size_t ordinal_count) : words_((ordinal_count + FILTER_BLOCK_SIZE - 1) / FILTER_BLOCK_SIZE) {}
+
+    bool Contains(Ordinal ordinal) const
+    {
+        return (words_[ordinal / FILTER_BLOCK_SIZE] >> (ordinal % FILTER_BLOCK_SIZE)) & 1u;
+    }
+
+    /// @brief Количество установленных бит
+    size_t Count() const;
+
+    uint64_t &Word(size_t index) { return words_[index]; }
+    size_t WordCount() const { return words_.size(); }
+
+private:
+    std::vector<uint64_t> words_;
+};
+
+/// @brief Фильтры документов, известные на этапе компиляции.
+/// Каждый фильтр можно вызвать как обычный предикат (id, status, rating),
+/// а поисковый сервер вычисляет его целыми блоками по колонкам атрибутов.
+/// Фильтры комбинируются операторами &&, || и !.
+namespace filter
+{
+    /// @brief Результат вычисления на блоке: 0xFF - документ прошёл, 0 - нет
+    using BlockHits = std::array<uint8_t, FILTER_BLOCK_SIZE>;
+
+    /// @brief Рейтинг в диапазоне [first, last]. Если фильтр оставляет малую долю документов,
+    /// кандидаты берутся из индекса рейтингов, а не вычисляются по всем документам
+    struct RatingInRange
+    {
+        int first;
+        int last;
+
+        bool operator()(int, DocumentStatus, int rating) const { return first <= rating && rating <= last; }
+        void EvaluateBlock(const DocumentAttributes &attributes, size_t first_ordinal, size_t count, BlockHits &hits) const;
+        std::optional<DocumentStatus> GetRequiredStatus() const { return std::nullopt; }
+        std::optional<RatingInRange> GetRatingRange() const { return *this; }
+    };
+
+    struct Status
+    {
+        DocumentStatus status;
+
+        bool operator()(int, DocumentStatus document_status, int) const { return document_status == status; }
+        void EvaluateBlock(const DocumentAttributes &attributes, size_t first, size_t count, BlockHits &hits) const;
+        std::optional<DocumentStatus> GetRequiredStatus() const { return status; }
+        std::optional<RatingInRange> GetRatingRange() const { return std::nullopt; }
+    };
+
+    struct RatingAtLeast
+    {
+        int rating;
+
+        bool operator()(int, DocumentStatus, int document_rating) const { return document_rating >= rating; }
+        void EvaluateBlock(const DocumentAttributes &attributes, size_t first, size_t count, BlockHits &hits) const;
+        std::optional<DocumentStatus> GetRequiredStatus() const { return std::nullopt; }
+        std::optional<RatingInRange> GetRatingRange() const { return RatingInRange{rating, INT_MAX}; }
+    };
+
+    /// @brief id документа в диапазоне [first, last]
+    struct IdInRange
+    {
+        int first;
+        int last;
+
+        bool operator()(int document_id, DocumentStatus, int) const { return first <= document_id && document_id <= last; }
+        void EvaluateBlock(const DocumentAttributes &attributes, size_t first_ordinal, size_t count, BlockHits &hits) const;
+        std::optional<DocumentStatus> GetRequiredStatus() const { return std::nullopt; }
+        std::optional<RatingInRange> GetRatingRange() const { return std::nullopt; }
+    };
+
+    struct IdParity
+    {
+        bool even;
+
+        bool operator()(int document_id, DocumentStatus, int) const { return (document_id % 2 == 0) == even; }
+        void EvaluateBlock(const DocumentAttributes &attributes, size_t first, size_t count, BlockHits &hits) const;
+        std::optional<DocumentStatus> GetRequiredStatus() const { return std::nullopt; }
+        std::optional<RatingInRange> GetRatingRange() const { return std::nullopt; }
+    };
+
+    inline IdParity EvenId() { return {true}; }
+    inline IdParity OddId() { return {false}; }
+
+    template <typename Lhs, typename Rhs>
+    struct And
+    {
+        Lhs lhs;
+        Rhs rhs;
+
+        bool operator()(int document_id, DocumentStatus status, int rating) const
+        {
+            return lhs(document_id, status, rating) && rhs(document_id, status, rating);
+        }
+
+        void EvaluateBlock(const DocumentAttributes &attributes, size_t first, size_t count, BlockHits &hits) const
+        {
+            BlockHits rhs_hits{};
+            lhs.EvaluateBlock(attributes, first, count, hits);
+            rhs.EvaluateBlock(attributes, first, count, rhs_hits);
+            for (size_t i = 0; i < FILTER_BLOCK_SIZE; ++i)
+            {
+                hits[i] &= rhs_hits[i];
+            }
+        }
+
+        std::optional<DocumentStatus> GetRequiredStatus() const
+        {
+            const auto status = lhs.GetRequiredStatus();
+            return status ? status : rhs.GetRequiredStatus();
+        }
+
+        std::optional<RatingInRange> GetRatingRange() const
+        {
+            const auto lhs_range = lhs.GetRatingRange();
+            const auto rhs_range = rhs.GetRatingRange();
+            if (lhs_range && rhs_range)
+            {
+                return RatingInRange{std::max(lhs_range->first, rhs_range->first), std::min(lhs_range->last, rhs_range->last)};
+            }
+            return lhs_range ? lhs_range : rhs_range;
+        }
+    };
+
+    template <typename Lhs, typename Rhs>
+    struct Or
+    {
+        Lhs lhs;
+        Rhs rhs;
+
+        bool operator()(int document_id, DocumentStatus status, int rating) const
+        {
+            return lhs(document_id, status, rating) || rhs(document_id, status, rating);
+        }
+
+        void EvaluateBlock(const DocumentAttributes &attributes, size_t first, size_t count, BlockHits &hits) const
+        {
+            BlockHits rhs_hits{};
+            lhs.EvaluateBlock(attributes, first, count, hits);
+            rhs.EvaluateBlock(attributes, first, count, rhs_hits);
+            for (size_t i = 0; i < FILTER_BLOCK_SIZE; ++i)
+            {
+                hits[i] |= rhs_hits[i];
+            }
+        }
+
+        std::optional<DocumentStatus> GetRequiredStatus() const
+        {
+            const auto lhs_status = lhs.GetRequiredStatus();
+            return lhs_status == rhs.GetRequiredStatus() ? lhs_status : std::nullopt;
+        }
+
+        std::optional<RatingInRange> GetRatingRange() const
+        {
+            // объединение диапазонов заменяется охватывающим диапазоном, лишние кандидаты отсеет сам фильтр
+            const auto lhs_range = lhs.GetRatingRange();
+            const auto rhs_range = rhs.GetRatingRange();
+            if (lhs_range && rhs_range)
+            {
+                return RatingInRange{std::min(lhs_range->first, rhs_range->first), std::max(lhs_range->last, rhs_range->last)};
+            }
+            return std::nullopt;
+        }
+    };
+
+    template <typename Filter>
+    struct Not
+    {
+        Filter filter;
+
+        bool operator()(int document_id, DocumentStatus status, int rating) const
+        {
+            return !filter(document_id, status, rating);
+        }
+
+        void EvaluateBlock(const DocumentAttributes &attributes, size_t first, size_t count, BlockHits &hits) const
+        {
+            filter.EvaluateBlock(attributes, first, count, hits);
+            for (size_t i = 0; i < FILTER_BLOCK_SIZE; ++i)
+            {
+                hits[i] = ~hits[i];
+            }
+        }
+
+        std::optional<DocumentStatus> GetRequiredStatus() const { return std::nullopt; }
+        std::optional<RatingInRange> GetRatingRange() const { return std::nullopt; }
+    };
+
+    template <typename T>
+    struct IsFilter : std::false_type
+    {
+    };
+    template <>
+    struct IsFilter<Status> : std::true_type
+    {
+    };
+    template <>
+    struct IsFilter<RatingAtLeast> : std::true_type
+    {
+    };
+    template <>
+    struct IsFilter<RatingInRange> : std::true_type
+    {
+    };
+    template <>
+    struct IsFilter<IdInRange> : std::true_type
+    {
+    };
+    template <>
+    struct IsFilter<IdParity> : std::true_type
+    {
+    };
+    template <typename Lhs, typename Rhs>
+    struct IsFilter<And<Lhs, Rhs>> : std::true_type
+    {
+    };
+    template <typename Lhs, typename Rhs>
+    struct IsFilter<Or<Lhs, Rhs>> : std::true_type
+    {
+    };
+    template <typename Filter>
+    struct IsFilter<Not<Filter>> : std::true_type
+    {
+    };
+
+    template <typename T>
+    inline constexpr bool IS_FILTER = IsFilter<std::decay_t<T>>::value;
+
+    template <typename Lhs, typename Rhs, typename = std::enable_if_t<IS_FILTER<Lhs> && IS_FILTER<Rhs>>>
+    And<Lhs, Rhs> operator&&(const Lhs &lhs, const Rhs &rhs)
+    {
+        return {lhs, rhs};
+    }
+
+    template <typename Lhs, typename Rhs, typename = std::enable_if_t<IS_FILTER<Lhs> && IS_FILTER<Rhs>>>
+    Or<Lhs, Rhs> operator||(const Lhs &lhs, const Rhs &rhs)
+    {
+        return {lhs, rhs};
+    }
+
+    template <typename Filter, typename = std::enable_if_t<IS_FILTER<Filter>>>
+    Not<Filter> operator!(const Filter &filter)
+    {
+        return {filter};
+    }
+
+    /// @brief Упаковать байтовую маску блока в 64-битное слово
+    uint64_t PackHits(const BlockHits &hits, size_t count);
+
+    /// @brief Маска живых (не удалённых) документов блока
+    void EvaluateAlive(const DocumentAttributes &attributes, size_t first, size_t count, BlockHits &hits);
+
+    /// @brief Вычислить фильтр по всем документам блоками по FILTER_BLOCK_SIZE
+    template <typename Filter>
+    CandidateBitmap BuildCandidateBitmap(const DocumentAttributes &attributes, const Filter &filter)
+    {
+        const size_t ordinal_count = attributes.GetOrdinalCount();
+        CandidateBitmap bitmap{ordinal_count};
+
+        // циклы идут по всему блоку: байты за count последнего неполного блока остаются от предыдущего блока
+        // (нули, если блок один) и отбрасываются только тем, что PackHits берёт первые count байт
+        BlockHits hits{};
+        BlockHits alive{};
+        for (size_t word = 0; word < bitmap.WordCount(); ++word)
+        {
+            const size_t first = word * FILTER_BLOCK_SIZE;
+            const size_t count = std::min(FILTER_BLOCK_SIZE, ordinal_count - first);
+
+            filter.EvaluateBlock(attributes, first, count, hits);
+            EvaluateAlive(attributes, first, count, alive);
+            for (size_t i = 0; i < FILTER_BLOCK_SIZE; ++i)
+            {
+                hits[i] &= alive[i];
+            }
+            bitmap.Word(word) = PackHits(hits, count);
+        }
+        return bitmap;
+    }
+}
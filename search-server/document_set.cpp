@@ -0,0 +1,689 @@
+#include <algorithm>
+#include <bit>
+#include <iterator>
+#include "document_set.h"
+
+namespace
+{
+    const uint32_t BLOCK_VALUE_COUNT = 65536;
+
+    void SetBit(uint64_t *words, uint32_t bit)
+    {
+        words[bit / 64] |= uint64_t{1} << (bit % 64);
+    }
+
+    /// @brief Установить биты [first, last]
+    void SetRange(uint64_t *words, uint32_t first, uint32_t last)
+    {
+        const uint32_t first_word = first / 64;
+        const uint32_t last_word = last / 64;
+        const uint64_t first_mask = ~uint64_t{0} << (first % 64);
+        const uint64_t last_mask = ~uint64_t{0} >> (63 - last % 64);
+        if (first_word == last_word)
+        {
+            words[first_word] |= first_mask & last_mask;
+            return;
+        }
+        words[first_word] |= first_mask;
+        std::fill(words + first_word + 1, words + last_word, ~uint64_t{0});
+        words[last_word] |= last_mask;
+    }
+
+    /// @brief Первый установленный (или, при inverted, сброшенный) бит не раньше from, BLOCK_VALUE_COUNT - если его нет
+    uint32_t FindBit(const uint64_t *words, uint32_t from, bool inverted)
+    {
+        if (from >= BLOCK_VALUE_COUNT)
+        {
+            return BLOCK_VALUE_COUNT;
+        }
+        const uint64_t flip = inverted ? ~uint64_t{0} : 0;
+        size_t word = from / 64;
+        uint64_t bits = (words[word] ^ flip) & (~uint64_t{0} << (from % 64));
+        while (bits == 0)
+        {
+            if (++word == DocumentSet::BITMAP_WORD_COUNT)
+            {
+                return BLOCK_VALUE_COUNT;
+            }
+            bits = words[word] ^ flip;
+        }
+        return static_cast<uint32_t>(word * 64 + std::countr_zero(bits));
+    }
+
+    /// @brief Первый интервал, заканчивающийся не раньше low. runs - пары (первое, последнее) значение
+    size_t FindRun(const std::vector<uint16_t> &runs, uint16_t low)
+    {
+        size_t first = 0;
+        size_t count = runs.size() / 2;
+        while (count > 0)
+        {
+            const size_t step = count / 2;
+            if (runs[2 * (first + step) + 1] < low)
+            {
+                first += step + 1;
+                count -= step + 1;
+            }
+            else
+            {
+                count = step;
+            }
+        }
+        return first;
+    }
+}
+
+///
+/// Iterator
+///
+
+DocumentSet::Iterator::Iterator(const DocumentSet *set, size_t container) : set_(set), container_(container)
+{
+    if (container_ < set_->keys_.size())
+    {
+        EnterContainer();
+    }
+}
+
+void DocumentSet::Iterator::EnterContainer()
+{
+    const Container &container = set_->containers_[container_];
+    position_ = 0;
+    if (container.kind == ContainerKind::BITMAP)
+    {
+        low_ = static_cast<uint16_t>(FindBit(container.words.data(), 0, false));
+    }
+    else
+    {
+        // первое значение массива или начало первого интервала
+        low_ = container.values.front();
+    }
+}
+
+DocumentSet::Iterator &DocumentSet::Iterator::operator++()
+{
+    const Container &container = set_->containers_[container_];
+    switch (container.kind)
+    {
+    case ContainerKind::ARRAY:
+        if (++position_ < container.values.size())
+        {
+            low_ = container.values[position_];
+            return *this;
+        }
+        break;
+    case ContainerKind::BITMAP:
+    {
+        const uint32_t next = FindBit(container.words.data(), uint32_t{low_} + 1, false);
+        if (next < BLOCK_VALUE_COUNT)
+        {
+            low_ = static_cast<uint16_t>(next);
+            return *this;
+        }
+        break;
+    }
+    case ContainerKind::RUN:
+        if (low_ < container.values[2 * position_ + 1])
+        {
+            ++low_;
+            return *this;
+        }
+        if (2 * ++position_ < container.values.size())
+        {
+            low_ = container.values[2 * position_];
+            return *this;
+        }
+        break;
+    }
+
+    ++container_;
+    position_ = 0;
+    low_ = 0;
+    if (container_ < set_->keys_.size())
+    {
+        EnterContainer();
+    }
+    return *this;
+}
+
+///
+/// public
+///
+
+DocumentSet DocumentSet::FromSorted(std::span<const Value> values)
+{
+    DocumentSet result;
+    for (size_t first = 0; first < values.size();)
+    {
+        const uint16_t key = static_cast<uint16_t>(values[first] >> 16);
+        size_t last = first;
+        while (last < values.size() && values[last] >> 16 == key)
+        {
+            ++last;
+        }
+
+        Container container;
+        container.cardinality = static_cast<uint32_t>(last - first);
+        if (container.cardinality <= MAX_ARRAY_SIZE)
+        {
+            container.values.reserve(container.cardinality);
+            for (size_t i = first; i < last; ++i)
+            {
+                container.values.push_back(static_cast<uint16_t>(values[i]));
+            }
+        }
+        else
+        {
+            container.kind = ContainerKind::BITMAP;
+            container.words.assign(BITMAP_WORD_COUNT, 0);
+            for (size_t i = first; i < last; ++i)
+            {
+                SetBit(container.words.data(), values[i] & 0xFFFF);
+            }
+        }
+
+        result.keys_.push_back(key);
+        result.containers_.push_back(std::move(container));
+        result.cardinality_ += last - first;
+        first = last;
+    }
+    return result;
+}
+
+bool DocumentSet::Add(Value value)
+{
+    const uint16_t key = static_cast<uint16_t>(value >> 16);
+    const size_t index = FindContainer(key);
+    if (index == keys_.size() || keys_[index] != key)
+    {
+        keys_.insert(keys_.begin() + index, key);
+        containers_.insert(containers_.begin() + index, Container{});
+    }
+    if (!ContainerAdd(containers_[index], static_cast<uint16_t>(value)))
+    {
+        return false;
+    }
+    ++cardinality_;
+    return true;
+}
+
+bool DocumentSet::Remove(Value value)
+{
+    const uint16_t key = static_cast<uint16_t>(value >> 16);
+    const size_t index = FindContainer(key);
+    if (index == keys_.size() || keys_[index] != key || !ContainerRemove(containers_[index], static_cast<uint16_t>(value)))
+    {
+        return false;
+    }
+    --cardinality_;
+    if (containers_[index].cardinality == 0)
+    {
+        keys_.erase(keys_.begin() + index);
+        containers_.erase(containers_.begin() + index);
+    }
+    return true;
+}
+
+bool DocumentSet::Contains(Value value) const
+{
+    const uint16_t key = static_cast<uint16_t>(value >> 16);
+    const size_t index = FindContainer(key);
+    return index < keys_.size() && keys_[index] == key && ContainerContains(containers_[index], static_cast<uint16_t>(value));
+}
+
+void DocumentSet::clear()
+{
+    keys_.clear();
+    containers_.clear();
+    cardinality_ = 0;
+}
+
+DocumentSet &DocumentSet::operator&=(const DocumentSet &other)
+{
+    Combine(other, false, false, ContainerAnd);
+    return *this;
+}
+
+DocumentSet &DocumentSet::operator|=(const DocumentSet &other)
+{
+    Combine(other, true, true, ContainerOr);
+    return *this;
+}
+
+DocumentSet &DocumentSet::operator-=(const DocumentSet &other)
+{
+    Combine(other, true, false, ContainerAndNot);
+    return *this;
+}
+
+void DocumentSet::RunOptimize()
+{
+    for (Container &container : containers_)
+    {
+        // интервал занимает два значения: выгоден, если их меньше половины значений массива
+        if (container.kind == ContainerKind::ARRAY)
+        {
+            ConvertToRuns(container, (container.cardinality - 1) / 2);
+        }
+        else if (container.kind == ContainerKind::BITMAP)
+        {
+            ConvertToRuns(container, MAX_RUN_COUNT);
+        }
+    }
+}
+
+size_t DocumentSet::GetMemoryUsage() const
+{
+    size_t bytes = keys_.capacity() * sizeof(uint16_t) + containers_.capacity() * sizeof(Container);
+    for (const Container &container : containers_)
+    {
+        bytes += container.values.capacity() * sizeof(uint16_t) + container.words.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+///
+/// private
+///
+
+size_t DocumentSet::FindContainer(uint16_t key) const
+{
+    return std::lower_bound(keys_.begin(), keys_.end(), key) - keys_.begin();
+}
+
+bool DocumentSet::ContainerContains(const Container &container, uint16_t low)
+{
+    switch (container.kind)
+    {
+    case ContainerKind::ARRAY:
+        return std::binary_search(container.values.begin(), container.values.end(), low);
+    case ContainerKind::BITMAP:
+        return (container.words[low / 64] >> (low % 64)) & 1u;
+    case ContainerKind::RUN:
+    {
+        const size_t run = FindRun(container.values, low);
+        return 2 * run < container.values.size() && container.values[2 * run] <= low;
+    }
+    }
+    return false;
+}
+
+bool DocumentSet::ContainerAdd(Container &container, uint16_t low)
+{
+    switch (container.kind)
+    {
+    case ContainerKind::ARRAY:
+    {
+        const auto it = std::lower_bound(container.values.begin(), container.values.end(), low);
+        if (it != container.values.end() && *it == low)
+        {
+            return false;
+        }
+        if (container.values.size() < MAX_ARRAY_SIZE)
+        {
+            container.values.insert(it, low);
+            ++container.cardinality;
+            return true;
+        }
+        // переполненный массив становится битовой картой, а если значения идут подряд - интервалами
+        std::vector<uint64_t> words(BITMAP_WORD_COUNT);
+        FillWords(container, words.data());
+        SetBit(words.data(), low);
+        container = FromWords(std::move(words));
+        ConvertToRuns(container, MAX_RUN_COUNT);
+        return true;
+    }
+    case ContainerKind::BITMAP:
+    {
+        uint64_t &word = container.words[low / 64];
+        const uint64_t bit = uint64_t{1} << (low % 64);
+        if (word & bit)
+        {
+            return false;
+        }
+        word |= bit;
+        ++container.cardinality;
+        return true;
+    }
+    case ContainerKind::RUN:
+    {
+        std::vector<uint16_t> &runs = container.values;
+        const size_t run = FindRun(runs, low);
+        const size_t run_count = runs.size() / 2;
+        if (run < run_count && runs[2 * run] <= low)
+        {
+            return false;
+        }
+        const bool extends_previous = run > 0 && uint32_t{runs[2 * run - 1]} + 1 == low;
+        const bool extends_next = run < run_count && uint32_t{low} + 1 == runs[2 * run];
+        if (extends_previous && extends_next)
+        {
+            runs[2 * run - 1] = runs[2 * run + 1];
+            runs.erase(runs.begin() + 2 * run, runs.begin() + 2 * run + 2);
+        }
+        else if (extends_previous)
+        {
+            runs[2 * run - 1] = low;
+        }
+        else if (extends_next)
+        {
+            runs[2 * run] = low;
+        }
+        else
+        {
+            const uint16_t single[] = {low, low};
+            runs.insert(runs.begin() + 2 * run, std::begin(single), std::end(single));
+        }
+        ++container.cardinality;
+
+        if (runs.size() / 2 > MAX_RUN_COUNT)
+        {
+            std::vector<uint64_t> words(BITMAP_WORD_COUNT);
+            FillWords(container, words.data());
+            container = FromWords(std::move(words));
+        }
+        return true;
+    }
+    }
+    return false;
+}
+
+bool DocumentSet::ContainerRemove(Container &container, uint16_t low)
+{
+    switch (container.kind)
+    {
+    case ContainerKind::ARRAY:
+    {
+        const auto it = std::lower_bound(container.values.begin(), container.values.end(), low);
+        if (it == container.values.end() || *it != low)
+        {
+            return false;
+        }
+        container.values.erase(it);
+        --container.cardinality;
+        return true;
+    }
+    case ContainerKind::BITMAP:
+    {
+        uint64_t &word = container.words[low / 64];
+        const uint64_t bit = uint64_t{1} << (low % 64);
+        if (!(word & bit))
+        {
+            return false;
+        }
+        word &= ~bit;
+        if (--container.cardinality <= MAX_ARRAY_SIZE)
+        {
+            container = FromWords(std::move(container.words));
+        }
+        return true;
+    }
+    case ContainerKind::RUN:
+    {
+        std::vector<uint16_t> &runs = container.values;
+        const size_t run = FindRun(runs, low);
+        if (2 * run >= runs.size() || runs[2 * run] > low)
+        {
+            return false;
+        }
+        uint16_t &first = runs[2 * run];
+        uint16_t &last = runs[2 * run + 1];
+        if (first == last)
+        {
+            runs.erase(runs.begin() + 2 * run, runs.begin() + 2 * run + 2);
+        }
+        else if (low == first)
+        {
+            ++first;
+        }
+        else if (low == last)
+        {
+            --last;
+        }
+        else
+        {
+            // интервал разрезается на два
+            const uint16_t tail[] = {static_cast<uint16_t>(low + 1), last};
+            last = static_cast<uint16_t>(low - 1);
+            runs.insert(runs.begin() + 2 * run + 2, std::begin(tail), std::end(tail));
+        }
+        --container.cardinality;
+
+        if (runs.size() / 2 > MAX_RUN_COUNT)
+        {
+            std::vector<uint64_t> words(BITMAP_WORD_COUNT);
+            FillWords(container, words.data());
+            container = FromWords(std::move(words));
+        }
+        return true;
+    }
+    }
+    return false;
+}
+
+void DocumentSet::FillWords(const Container &container, uint64_t *words)
+{
+    switch (container.kind)
+    {
+    case ContainerKind::ARRAY:
+        std::fill(words, words + BITMAP_WORD_COUNT, 0);
+        for (const uint16_t low : container.values)
+        {
+            SetBit(words, low);
+        }
+        break;
+    case ContainerKind::BITMAP:
+        std::copy(container.words.begin(), container.words.end(), words);
+        break;
+    case ContainerKind::RUN:
+        std::fill(words, words + BITMAP_WORD_COUNT, 0);
+        for (size_t i = 0; i < container.values.size(); i += 2)
+        {
+            SetRange(words, container.values[i], container.values[i + 1]);
+        }
+        break;
+    }
+}
+
+DocumentSet::Container DocumentSet::FromWords(std::vector<uint64_t> words)
+{
+    Container container;
+    for (const uint64_t word : words)
+    {
+        container.cardinality += std::popcount(word);
+    }
+    if (container.cardinality > MAX_ARRAY_SIZE)
+    {
+        container.kind = ContainerKind::BITMAP;
+        container.words = std::move(words);
+        return container;
+    }
+
+    container.values.reserve(container.cardinality);
+    for (size_t i = 0; i < words.size(); ++i)
+    {
+        for (uint64_t word = words[i]; word != 0; word &= word - 1)
+        {
+            container.values.push_back(static_cast<uint16_t>(i * 64 + std::countr_zero(word)));
+        }
+    }
+    return container;
+}
+
+DocumentSet::Container DocumentSet::ContainerAnd(const Container &lhs, const Container &rhs)
+{
+    Container result;
+    if (lhs.kind == ContainerKind::ARRAY && rhs.kind == ContainerKind::ARRAY)
+    {
+        std::set_intersection(lhs.values.begin(), lhs.values.end(), rhs.values.begin(), rhs.values.end(),
+                              std::back_inserter(result.values));
+    }
+    else if (lhs.kind == ContainerKind::ARRAY || rhs.kind == ContainerKind::ARRAY)
+    {
+        // пересечение не больше массива: его значения проверяются во втором контейнере
+        const Container &array = lhs.kind == ContainerKind::ARRAY ? lhs : rhs;
+        const Container &other = lhs.kind == ContainerKind::ARRAY ? rhs : lhs;
+        std::copy_if(array.values.begin(), array.values.end(), std::back_inserter(result.values), [&other](uint16_t low)
+                     { return ContainerContains(other, low); });
+    }
+    else
+    {
+        std::vector<uint64_t> words(BITMAP_WORD_COUNT);
+        std::vector<uint64_t> rhs_words(BITMAP_WORD_COUNT);
+        FillWords(lhs, words.data());
+        FillWords(rhs, rhs_words.data());
+        for (size_t i = 0; i < BITMAP_WORD_COUNT; ++i)
+        {
+            words[i] &= rhs_words[i];
+        }
+        return FromWords(std::move(words));
+    }
+    result.cardinality = static_cast<uint32_t>(result.values.size());
+    return result;
+}
+
+DocumentSet::Container DocumentSet::ContainerOr(const Container &lhs, const Container &rhs)
+{
+    if (lhs.kind == ContainerKind::ARRAY && rhs.kind == ContainerKind::ARRAY && lhs.values.size() + rhs.values.size() <= MAX_ARRAY_SIZE)
+    {
+        Container result;
+        std::set_union(lhs.values.begin(), lhs.values.end(), rhs.values.begin(), rhs.values.end(), std::back_inserter(result.values));
+        result.cardinality = static_cast<uint32_t>(result.values.size());
+        return result;
+    }
+
+    std::vector<uint64_t> words(BITMAP_WORD_COUNT);
+    FillWords(lhs, words.data());
+    if (rhs.kind == ContainerKind::ARRAY)
+    {
+        for (const uint16_t low : rhs.values)
+        {
+            SetBit(words.data(), low);
+        }
+    }
+    else
+    {
+        std::vector<uint64_t> rhs_words(BITMAP_WORD_COUNT);
+        FillWords(rhs, rhs_words.data());
+        for (size_t i = 0; i < BITMAP_WORD_COUNT; ++i)
+        {
+            words[i] |= rhs_words[i];
+        }
+    }
+    return FromWords(std::move(words));
+}
+
+DocumentSet::Container DocumentSet::ContainerAndNot(const Container &lhs, const Container &rhs)
+{
+    if (lhs.kind == ContainerKind::ARRAY)
+    {
+        Container result;
+        std::copy_if(lhs.values.begin(), lhs.values.end(), std::back_inserter(result.values), [&rhs](uint16_t low)
+                     { return !ContainerContains(rhs, low); });
+        result.cardinality = static_cast<uint32_t>(result.values.size());
+        return result;
+    }
+
+    std::vector<uint64_t> words(BITMAP_WORD_COUNT);
+    FillWords(lhs, words.data());
+    if (rhs.kind == ContainerKind::ARRAY)
+    {
+        for (const uint16_t low : rhs.values)
+        {
+            words[low / 64] &= ~(uint64_t{1} << (low % 64));
+        }
+    }
+    else
+    {
+        std::vector<uint64_t> rhs_words(BITMAP_WORD_COUNT);
+        FillWords(rhs, rhs_words.data());
+        for (size_t i = 0; i < BITMAP_WORD_COUNT; ++i)
+        {
+            words[i] &= ~rhs_words[i];
+        }
+    }
+    return FromWords(std::move(words));
+}
+
+bool DocumentSet::ConvertToRuns(Container &container, size_t max_run_count)
+{
+    std::vector<uint64_t> words(BITMAP_WORD_COUNT);
+    FillWords(container, words.data());
+
+    // интервал начинается там, где бит установлен, а предыдущий сброшен
+    size_t run_count = 0;
+    uint64_t carry = 0;
+    for (const uint64_t word : words)
+    {
+        run_count += std::popcount(word & ~(word << 1 | carry));
+        carry = word >> 63;
+    }
+    if (run_count > max_run_count)
+    {
+        return false;
+    }
+
+    std::vector<uint16_t> runs;
+    runs.reserve(2 * run_count);
+    for (uint32_t first = FindBit(words.data(), 0, false); first < BLOCK_VALUE_COUNT;)
+    {
+        const uint32_t end = FindBit(words.data(), first, true);
+        runs.push_back(static_cast<uint16_t>(first));
+        runs.push_back(static_cast<uint16_t>(end - 1));
+        first = FindBit(words.data(), end, false);
+    }
+
+    container.kind = ContainerKind::RUN;
+    container.values = std::move(runs);
+    container.words = std::vector<uint64_t>{};
+    return true;
+}
+
+template <typename Operation>
+void DocumentSet::Combine(const DocumentSet &other, bool keep_lhs_only, bool keep_rhs_only, Operation operation)
+{
+    std::vector<uint16_t> keys;
+    std::vector<Container> containers;
+    size_t cardinality = 0;
+    const auto append = [&](uint16_t key, Container container)
+    {
+        if (container.cardinality > 0)
+        {
+            cardinality += container.cardinality;
+            keys.push_back(key);
+            containers.push_back(std::move(container));
+        }
+    };
+
+    // блоки сливаются по ключам, операция над контейнерами вызывается только для общих ключей
+    size_t lhs = 0;
+    size_t rhs = 0;
+    while (lhs < keys_.size() || rhs < other.keys_.size())
+    {
+        if (rhs == other.keys_.size() || (lhs < keys_.size() && keys_[lhs] < other.keys_[rhs]))
+        {
+            if (keep_lhs_only)
+            {
+                append(keys_[lhs], std::move(containers_[lhs]));
+            }
+            ++lhs;
+        }
+        else if (lhs == keys_.size() || other.keys_[rhs] < keys_[lhs])
+        {
+            if (keep_rhs_only)
+            {
+                append(other.keys_[rhs], other.containers_[rhs]);
+            }
+            ++rhs;
+        }
+        else
+        {
+            append(keys_[lhs], operation(containers_[lhs], other.containers_[rhs]));
+            ++lhs;
+            ++rhs;
+        }
+    }
+
+    keys_ = std::move(keys);
+    containers_ = std::move(containers);
+    cardinality_ = cardinality;
+}
@@ -0,0 +1,233 @@
+#pragma once
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <vector>
+
+/// @brief Сжатое множество неотрицательных номеров (порядковых номеров или id документов) в духе Roaring.
+/// Значения делятся на блоки по старшим 16 битам, младшие биты блока хранятся в одном из контейнеров:
+/// отсортированный массив для разреженных блоков, битовая карта на 65536 бит для плотных
+/// и список интервалов для блоков из длинных последовательностей, например подряд выданных номеров
+class DocumentSet
+{
+public:
+    using Value = uint32_t;
+
+    /// @brief Массив длиннее этого занимает больше битовой карты блока и заменяется ею
+    static constexpr size_t MAX_ARRAY_SIZE = 4096;
+    /// @brief Интервал занимает 4 байта: больше MAX_RUN_COUNT интервалов занимают не меньше битовой карты блока
+    static constexpr size_t MAX_RUN_COUNT = 2047;
+    static constexpr size_t BITMAP_WORD_COUNT = 1024;
+
+private:
+    enum class ContainerKind : uint8_t
+    {
+        ARRAY,
+        BITMAP,
+        RUN,
+    };
+
+    struct Container
+    {
+        ContainerKind kind = ContainerKind::ARRAY;
+        uint32_t cardinality = 0;
+        std::vector<uint16_t> values; // ARRAY - младшие биты по возрастанию, RUN - пары (первое, последнее) значение интервала
+        std::vector<uint64_t> words;  // BITMAP - BITMAP_WORD_COUNT слов
+    };
+
+public:
+    /// @brief Обход значений по возрастанию. Действителен до изменения множества
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Value;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Value;
+
+        Iterator() = default;
+
+        Value operator*() const { return static_cast<Value>(set_->keys_[container_]) << 16 | low_; }
+
+        Iterator &operator++();
+        Iterator operator++(int)
+        {
+            Iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const Iterator &other) const
+        {
+            return container_ == other.container_ && position_ == other.position_ && low_ == other.low_;
+        }
+
+    private:
+        friend class DocumentSet;
+
+        const DocumentSet *set_ = nullptr;
+        size_t container_ = 0;
+        size_t position_ = 0; // ARRAY - номер значения, RUN - номер интервала
+        uint16_t low_ = 0;
+
+        Iterator(const DocumentSet *set, size_t container);
+        void EnterContainer();
+    };
+
+    DocumentSet() = default;
+
+    /// @param values значения по возрастанию без повторов
+    static DocumentSet FromSorted(std::span<const Value> values);
+
+    /// @return false, если значение уже было в множестве
+    bool Add(Value value);
+    /// @return false, если значения не было в множестве
+    bool Remove(Value value);
+    bool Contains(Value value) const;
+
+    /// @brief Мощность множества
+    size_t size() const { return cardinality_; }
+    bool empty() const { return cardinality_ == 0; }
+    void clear();
+
+    DocumentSet &operator&=(const DocumentSet &other);
+    DocumentSet &operator|=(const DocumentSet &other);
+    /// @brief Разность множеств (ANDNOT)
+    DocumentSet &operator-=(const DocumentSet &other);
+
+    /// @brief Перевести в интервалы блоки, которые так занимают меньше памяти
+    void RunOptimize();
+
+    Iterator begin() const { return {this, 0}; }
+    Iterator end() const { return {this, keys_.size()}; }
+
+    /// @brief Вызвать visit(i) для каждого values[i], которое есть в множестве. Контейнер блока сливается
+    /// с отсортированными значениями за один проход, без поиска каждого значения
+    /// @param values значения по возрастанию
+    template <typename Visitor>
+    void IntersectSorted(std::span<const Value> values, Visitor visit) const;
+
+    /// @brief Приблизительный объём занятой динамической памяти
+    size_t GetMemoryUsage() const;
+
+private:
+    std::vector<uint16_t> keys_; // старшие 16 бит блоков по возрастанию
+    std::vector<Container> containers_;
+    size_t cardinality_ = 0;
+
+    size_t FindContainer(uint16_t key) const;
+
+    static bool ContainerContains(const Container &container, uint16_t low);
+    static bool ContainerAdd(Container &container, uint16_t low);
+    static bool ContainerRemove(Container &container, uint16_t low);
+    /// @brief Значения контейнера битами в words размером BITMAP_WORD_COUNT
+    static void FillWords(const Container &container, uint64_t *words);
+    /// @brief Контейнер из битовой карты: массив, если значений мало, иначе битовая карта
+    static Container FromWords(std::vector<uint64_t> words);
+    static Container ContainerAnd(const Container &lhs, const Container &rhs);
+    static Container ContainerOr(const Container &lhs, const Container &rhs);
+    static Container ContainerAndNot(const Container &lhs, const Container &rhs);
+    /// @brief Переписать контейнер интервалами, если их не больше max_run_count
+    static bool ConvertToRuns(Container &container, size_t max_run_count);
+
+    template <typename Operation>
+    void Combine(const DocumentSet &other, bool keep_lhs_only, bool keep_rhs_only, Operation operation);
+};
+
+template <typename Visitor>
+void DocumentSet::IntersectSorted(std::span<const Value> values, Visitor visit) const
+{
+    size_t index = 0;
+    for (size_t first = 0; first < values.size();)
+    {
+        const uint16_t key = static_cast<uint16_t>(values[first] >> 16);
+        size_t last = first;
+        while (last < values.size() && values[last] >> 16 == key)
+        {
+            ++last;
+        }
+        while (index < keys_.size() && keys_[index] < key)
+        {
+            ++index;
+        }
+        if (index == keys_.size())
+        {
+            return;
+        }
+
+        if (keys_[index] == key)
+        {
+            const Container &container = containers_[index];
+            size_t position = 0;
+            switch (container.kind)
+            {
+            case ContainerKind::ARRAY:
+                for (size_t i = first; i < last; ++i)
+                {
+                    const uint16_t low = static_cast<uint16_t>(values[i]);
+                    while (position < container.values.size() && container.values[position] < low)
+                    {
+                        ++position;
+                    }
+                    if (position == container.values.size())
+                    {
+                        break;
+                    }
+                    if (container.values[position] == low)
+                    {
+                        visit(i);
+                    }
+                }
+                break;
+            case ContainerKind::BITMAP:
+                for (size_t i = first; i < last; ++i)
+                {
+                    const uint16_t low = static_cast<uint16_t>(values[i]);
+                    if ((container.words[low / 64] >> (low % 64)) & 1u)
+                    {
+                        visit(i);
+                    }
+                }
+                break;
+            case ContainerKind::RUN:
+                for (size_t i = first; i < last; ++i)
+                {
+                    const uint16_t low = static_cast<uint16_t>(values[i]);
+                    while (2 * position < container.values.size() && container.values[2 * position + 1] < low)
+                    {
+                        ++position;
+                    }
+                    if (2 * position == container.values.size())
+                    {
+                        break;
+                    }
+                    if (container.values[2 * position] <= low)
+                    {
+                        visit(i);
+                    }
+                }
+                break;
+            }
+        }
+        first = last;
+    }
+}
+
+inline DocumentSet operator&(DocumentSet lhs, const DocumentSet &rhs)
+{
+    lhs &= rhs;
+    return lhs;
+}
+
+inline DocumentSet operator|(DocumentSet lhs, const DocumentSet &rhs)
+{
+    lhs |= rhs;
+    return lhs;
+}
+
+inline DocumentSet operator-(DocumentSet lhs, const DocumentSet &rhs)
+{
+    lhs -= rhs;
+    return lhs;
+}
@@ -0,0 +1,174 @@
+#include <stdexcept>
+#include <string>
+#include "executor.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+    // пул и номер рабочего потока, в котором выполняется код
+    thread_local const Executor *current_executor = nullptr;
+    thread_local size_t current_worker = 0;
+
+#ifdef _WIN32
+    constexpr size_t MAX_AFFINITY_CPU = sizeof(DWORD_PTR) * 8; // маска привязки - одно слово
+#else
+    constexpr size_t MAX_AFFINITY_CPU = CPU_SETSIZE;
+#endif
+
+    void SetThreadAffinity(std::thread &thread, size_t cpu)
+    {
+#ifdef _WIN32
+        SetThreadAffinityMask(thread.native_handle(), DWORD_PTR{1} << cpu);
+#else
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+#endif
+    }
+}
+
+Executor::Executor(size_t thread_count)
+{
+    ExecutorOptions options;
+    options.thread_count = std::max<size_t>(thread_count, 1);
+    Start(options);
+}
+
+Executor::Executor(const ExecutorOptions &options)
+{
+    Start(options);
+}
+
+void Executor::Start(const ExecutorOptions &options)
+{
+    for (const size_t cpu : options.cpu_affinity)
+    {
+        if (cpu >= MAX_AFFINITY_CPU)
+        {
+            throw std::invalid_argument("cpu " + std::to_string(cpu) + " is out of affinity range");
+        }
+    }
+    const size_t thread_count = options.thread_count > 0 ? options.thread_count : std::max(1u, std::thread::hardware_concurrency());
+    workers_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    threads_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        threads_.emplace_back([this, i]()
+                              { WorkerLoop(i); });
+        if (!options.cpu_affinity.empty())
+        {
+            // привязка не обязательна: если процессора нет, поток остаётся на усмотрение планировщика
+            SetThreadAffinity(threads_.back(), options.cpu_affinity[i % options.cpu_affinity.size()]);
+        }
+    }
+}
+
+Executor::~Executor()
+{
+    {
+        std::lock_guard guard{sleep_mutex_};
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread &thread : threads_)
+    {
+        thread.join();
+    }
+}
+
+Executor &Executor::GetDefault()
+{
+    static Executor executor;
+    return executor;
+}
+
+void Executor::Push(Task task)
+{
+    // задачи рабочего потока попадают в его очередь, остальные распределяются по кругу
+    size_t worker = GetCurrentWorker();
+    if (worker == workers_.size())
+    {
+        worker = next_worker_++ % workers_.size();
+    }
+    // счётчик растёт раньше, чем задачу видно другим потокам, иначе взявший её поток уменьшил бы его ниже нуля
+    {
+        std::lock_guard guard{sleep_mutex_};
+        ++pending_;
+    }
+    {
+        std::lock_guard guard{workers_[worker]->mutex};
+        workers_[worker]->tasks.push_back(std::move(task));
+    }
+    wake_.notify_one();
+}
+
+bool Executor::TryRunOne()
+{
+    const size_t self = GetCurrentWorker();
+    Task task;
+    if (self < workers_.size())
+    {
+        Worker &worker = *workers_[self];
+        std::lock_guard guard{worker.mutex};
+        if (!worker.tasks.empty())
+        {
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+        }
+    }
+    for (size_t offset = 1; !task && offset <= workers_.size(); ++offset)
+    {
+        Worker &victim = *workers_[(self + offset) % workers_.size()];
+        std::lock_guard guard{victim.mutex};
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+    if (!task)
+    {
+        return false;
+    }
+
+    --pending_;
+    task();
+    return true;
+}
+
+void Executor::WorkerLoop(size_t index)
+{
+    current_executor = this;
+    current_worker = index;
+    while (true)
+    {
+        if (TryRunOne())
+        {
+            continue;
+        }
+        std::unique_lock lock{sleep_mutex_};
+        wake_.wait(lock, [this]()
+                   { return pending_ > 0 || stopping_; });
+        if (stopping_ && pending_ == 0)
+        {
+            return;
+        }
+    }
+}
+
+size_t Executor::GetCurrentWorker() const
+{
+    return current_executor == this ? current_worker : workers_.size();
+}
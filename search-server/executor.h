@@ -0,0 +1,259 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <execution>
+#include <functional>
+#include <future>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/// @brief Настройки пула потоков
+struct ExecutorOptions
+{
+    /// @brief Число рабочих потоков, 0 - по числу ядер
+    size_t thread_count = 0;
+    /// @brief Номера процессоров для привязки потоков: поток i работает на cpu_affinity[i % size], пустой список - без привязки.
+    /// Номер за пределами маски привязки платформы (64 в Windows, CPU_SETSIZE в остальных) - std::invalid_argument
+    std::vector<size_t> cpu_affinity;
+};
+
+class ExecutorPolicy;
+
+/// @brief Пул потоков с перехватом задач (work stealing).
+/// У каждого потока своя очередь: свои задачи поток берёт с конца, чужие - с начала очереди другого потока.
+/// Поток, вызвавший ParallelFor, сам разбирает его индексы и ждёт только тех, что уже выполняются в других потоках,
+/// поэтому вложенный параллелизм не создаёт новых потоков и не приводит к взаимной блокировке.
+class Executor
+{
+public:
+    /// @param thread_count число рабочих потоков, 0 заменяется на 1
+    explicit Executor(size_t thread_count = std::thread::hardware_concurrency());
+    explicit Executor(const ExecutorOptions &options);
+    ~Executor();
+
+    Executor(const Executor &) = delete;
+    Executor &operator=(const Executor &) = delete;
+
+    size_t GetThreadCount() const { return threads_.size(); }
+
+    /// @brief Выполнить функцию в пуле
+    template <typename Function>
+    auto Submit(Function function) -> std::future<std::invoke_result_t<Function>>;
+
+    /// @brief Вызвать body(i) для всех i из [0, count) и дождаться завершения.
+    /// Первое выброшенное body исключение передаётся вызывающему
+    template <typename Body>
+    void ParallelFor(size_t count, Body body);
+
+    /// @brief Политика выполнения для шаблонов SearchServer, принимающих ExecutionPolicy
+    ExecutorPolicy Policy();
+
+    /// @brief Общий пул на все ядра процессора
+    static Executor &GetDefault();
+
+private:
+    using Task = std::function<void()>;
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_worker_{0};
+
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    std::atomic<size_t> pending_{0};
+    bool stopping_ = false;
+
+    void Start(const ExecutorOptions &options);
+    void Push(Task task);
+    /// @brief Выполнить одну задачу: свою с конца очереди или чужую с начала
+    bool TryRunOne();
+    void WorkerLoop(size_t index);
+    /// @brief Номер рабочего потока этого пула, вызывающего функцию, или GetThreadCount() для чужого потока
+    size_t GetCurrentWorker() const;
+};
+
+template <typename Function>
+auto Executor::Submit(Function function) -> std::future<std::invoke_result_t<Function>>
+{
+    using Result = std::invoke_result_t<Function>;
+    // std::function требует копируемости, а packaged_task только перемещается
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::move(function));
+    std::future<Result> result = task->get_future();
+    Push([task]()
+         { (*task)(); });
+    return result;
+}
+
+template <typename Body>
+void Executor::ParallelFor(size_t count, Body body)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    // помощник может начаться уже после возврата из ParallelFor: тогда индексов не осталось, body он не вызывает,
+    // а общее состояние держит сам
+    struct State
+    {
+        explicit State(size_t count) : done(static_cast<std::ptrdiff_t>(count)) {}
+
+        std::atomic<size_t> next{0};
+        std::latch done; // отсчитывает выполненные индексы
+        std::mutex error_mutex;
+        std::exception_ptr error;
+    };
+    const auto state = std::make_shared<State>(count);
+
+    const auto run = [count](State &state, Body &body)
+    {
+        for (size_t i = state.next++; i < count; i = state.next++)
+        {
+            try
+            {
+                body(i);
+            }
+            catch (...)
+            {
+                std::lock_guard guard{state.error_mutex};
+                if (!state.error)
+                {
+                    state.error = std::current_exception();
+                }
+            }
+            state.done.count_down();
+        }
+    };
+
+    const size_t helper_count = std::min(count, GetThreadCount()) - 1;
+    for (size_t i = 0; i < helper_count; ++i)
+    {
+        Push([state, &body, run]()
+             { run(*state, body); });
+    }
+
+    run(*state, body);
+    // свободных индексов больше нет, остаётся дождаться взятых другими потоками, не выполняя чужих задач
+    state->done.wait();
+
+    if (state->error)
+    {
+        std::rethrow_exception(state->error);
+    }
+}
+
+/// @brief Политика выполнения на пуле Executor, аналог std::execution::par с предсказуемым числом потоков.
+/// Алгоритмы, вызванные изнутри задачи того же пула, не создают потоков, а делят работу с ним
+class ExecutorPolicy
+{
+public:
+    explicit ExecutorPolicy(Executor &executor) : executor_(&executor) {}
+
+    Executor &GetExecutor() const { return *executor_; }
+
+private:
+    Executor *executor_;
+};
+
+inline ExecutorPolicy Executor::Policy()
+{
+    return ExecutorPolicy{*this};
+}
+
+template <typename ExecutionPolicy>
+inline constexpr bool IS_EXECUTOR_POLICY = std::is_same_v<std::decay_t<ExecutionPolicy>, ExecutorPolicy>;
+
+const size_t MIN_PARALLEL_SORT_CHUNK_SIZE = 4096; // меньшие части сортируются одним потоком
+
+/// @brief Сколько потоков может выполнять работу по политике
+template <typename ExecutionPolicy>
+size_t GetPolicyConcurrency(const ExecutionPolicy &policy)
+{
+    if constexpr (IS_EXECUTOR_POLICY<ExecutionPolicy>)
+    {
+        return policy.GetExecutor().GetThreadCount();
+    }
+    else if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>)
+    {
+        return 1;
+    }
+    else
+    {
+        return Executor::GetDefault().GetThreadCount();
+    }
+}
+
+/// @brief Вызвать body(i) для всех i из [0, count) по политике. Параллельные стандартные политики
+/// выполняются на общем пуле Executor::GetDefault(), как и ExecutorPolicy на своём пуле
+template <typename ExecutionPolicy, typename Body>
+void ParallelForEach(const ExecutionPolicy &policy, size_t count, Body body)
+{
+    if constexpr (IS_EXECUTOR_POLICY<ExecutionPolicy>)
+    {
+        policy.GetExecutor().ParallelFor(count, body);
+    }
+    else if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            body(i);
+        }
+    }
+    else
+    {
+        Executor::GetDefault().ParallelFor(count, body);
+    }
+}
+
+/// @brief Сортировка по политике. Для ExecutorPolicy части сортируются параллельно и сливаются попарно,
+/// параллельные стандартные политики сортируют так же на общем пуле Executor::GetDefault()
+template <typename ExecutionPolicy, typename RandomIt, typename Compare>
+void ParallelSort(const ExecutionPolicy &policy, RandomIt first, RandomIt last, Compare compare)
+{
+    if constexpr (IS_EXECUTOR_POLICY<ExecutionPolicy>)
+    {
+        const size_t size = static_cast<size_t>(last - first);
+        const size_t chunk_count = std::min(GetPolicyConcurrency(policy), size / MIN_PARALLEL_SORT_CHUNK_SIZE);
+        if (chunk_count <= 1)
+        {
+            std::sort(first, last, compare);
+            return;
+        }
+
+        const auto bound = [&](size_t chunk)
+        {
+            return first + static_cast<std::ptrdiff_t>(size * std::min(chunk, chunk_count) / chunk_count);
+        };
+        policy.GetExecutor().ParallelFor(chunk_count, [&](size_t chunk)
+                                         { std::sort(bound(chunk), bound(chunk + 1), compare); });
+        for (size_t width = 1; width < chunk_count; width *= 2)
+        {
+            policy.GetExecutor().ParallelFor((chunk_count + 2 * width - 1) / (2 * width), [&](size_t pair)
+                                             {
+                                                 const size_t left = pair * 2 * width;
+                                                 std::inplace_merge(bound(left), bound(left + width), bound(left + 2 * width), compare); });
+        }
+    }
+    else if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>)
+    {
+        std::sort(first, last, compare);
+    }
+    else
+    {
+        ParallelSort(Executor::GetDefault().Policy(), first, last, compare);
+    }
+}
@@ -0,0 +1,147 @@
+#include <stdexcept>
+#include "forward_index.h"
+
+void ForwardIndex::Add(Ordinal ordinal, std::span<const ForwardEntry> entries)
+{
+    if (ordinal < ranges_.size() && ranges_[ordinal].size > 0)
+        throw std::logic_error("document already has forward entries");
+
+    if (ordinal >= ranges_.size())
+    {
+        ranges_.resize(ordinal + 1, Range{entries_.size(), 0});
+    }
+    ranges_[ordinal] = {entries_.size(), static_cast<uint32_t>(entries.size())};
+    entries_.insert(entries_.end(), entries.begin(), entries.end());
+}
+
+void ForwardIndex::Remove(Ordinal ordinal)
+{
+    if (ordinal >= ranges_.size())
+    {
+        return;
+    }
+    removed_entries_ += ranges_[ordinal].size;
+    ranges_[ordinal].size = 0;
+
+    if (removed_entries_ * COMPACTION_DIVISOR > entries_.size())
+    {
+        Compact();
+    }
+}
+
+std::span<const ForwardEntry> ForwardIndex::Get(Ordinal ordinal) const
+{
+    if (ordinal >= ranges_.size())
+    {
+        return {};
+    }
+    return std::span<const ForwardEntry>{entries_}.subspan(ranges_[ordinal].offset, ranges_[ordinal].size);
+}
+
+size_t ForwardIndex::GetMemoryUsage() const
+{
+    return entries_.capacity() * sizeof(ForwardEntry) + ranges_.capacity() * sizeof(Range);
+}
+
+void ForwardIndex::Compact()
+{
+    // новый массив точного размера, чтобы освободить память, а не только сдвинуть записи
+    std::vector<ForwardEntry> entries;
+    entries.reserve(entries_.size() - removed_entries_);
+    for (Range &range : ranges_)
+    {
+        const auto first = entries_.begin() + range.offset;
+        range.offset = entries.size();
+        entries.insert(entries.end(), first, first + range.size);
+    }
+    entries_ = std::move(entries);
+    removed_entries_ = 0;
+}
+
+void TermIdIndex::Add(Ordinal ordinal, std::span<const ForwardEntry> entries)
+{
+    if (ordinal < ranges_.size() && ranges_[ordinal].size > 0)
+        throw std::logic_error("document already has term ids");
+
+    if (ordinal >= ranges_.size())
+    {
+        ranges_.resize(ordinal + 1, Range{bytes_.size(), 0});
+    }
+    const size_t offset = bytes_.size();
+    TermId previous = 0;
+    for (const ForwardEntry &entry : entries)
+    {
+        // по 7 бит разности в байте, старший бит - признак продолжения
+        uint64_t delta = entry.term - previous;
+        previous = entry.term;
+        while (delta >= 0x80)
+        {
+            bytes_.push_back(static_cast<uint8_t>(delta | 0x80));
+            delta >>= 7;
+        }
+        bytes_.push_back(static_cast<uint8_t>(delta));
+    }
+    ranges_[ordinal] = {offset, static_cast<uint32_t>(bytes_.size() - offset)};
+}
+
+void TermIdIndex::Remove(Ordinal ordinal)
+{
+    if (ordinal >= ranges_.size())
+    {
+        return;
+    }
+    removed_bytes_ += ranges_[ordinal].size;
+    ranges_[ordinal].size = 0;
+
+    if (removed_bytes_ * COMPACTION_DIVISOR > bytes_.size())
+    {
+        Compact();
+    }
+}
+
+std::vector<TermIdIndex::TermId> TermIdIndex::Get(Ordinal ordinal) const
+{
+    std::vector<TermId> terms;
+    if (ordinal >= ranges_.size())
+    {
+        return terms;
+    }
+    const uint8_t *data = bytes_.data() + ranges_[ordinal].offset;
+    const uint8_t *const end = data + ranges_[ordinal].size;
+    TermId term = 0;
+    while (data != end)
+    {
+        uint64_t delta = 0;
+        for (int shift = 0;; shift += 7)
+        {
+            const uint8_t byte = *data++;
+            delta |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                break;
+            }
+        }
+        term += static_cast<TermId>(delta);
+        terms.push_back(term);
+    }
+    return terms;
+}
+
+size_t TermIdIndex::GetMemoryUsage() const
+{
+    return bytes_.capacity() + ranges_.capacity() * sizeof(Range);
+}
+
+void TermIdIndex::Compact()
+{
+    std::vector<uint8_t> bytes;
+    bytes.reserve(bytes_.size() - removed_bytes_);
+    for (Range &range : ranges_)
+    {
+        const auto first = bytes_.begin() + range.offset;
+        range.offset = bytes.size();
+        bytes.insert(bytes.end(), first, first + range.size);
+    }
+    bytes_ = std::move(bytes);
+    removed_bytes_ = 0;
+}
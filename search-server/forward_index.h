@@ -0,0 +1,140 @@
+#pragma once
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "document_attributes.h"
+#include "term_dictionary.h"
+
+/// @brief Слово документа и его частота
+struct ForwardEntry
+{
+    TermDictionary::TermId term;
+    double term_freq;
+};
+
+/// @brief Слова документа с частотами, упорядоченные по номеру слова.
+/// Лёгкое представление над прямым индексом: действительно до следующего изменения поискового сервера
+class DocumentTerms
+{
+public:
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<std::string_view, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator() = default;
+        Iterator(const ForwardEntry *entry, const TermDictionary *dictionary) : entry_(entry), dictionary_(dictionary) {}
+
+        value_type operator*() const { return {dictionary_->GetWord(entry_->term), entry_->term_freq}; }
+
+        Iterator &operator++()
+        {
+            ++entry_;
+            return *this;
+        }
+        Iterator operator++(int)
+        {
+            Iterator previous = *this;
+            ++entry_;
+            return previous;
+        }
+
+        bool operator==(const Iterator &other) const { return entry_ == other.entry_; }
+
+    private:
+        const ForwardEntry *entry_ = nullptr;
+        const TermDictionary *dictionary_ = nullptr;
+    };
+
+    DocumentTerms() = default;
+    DocumentTerms(std::span<const ForwardEntry> entries, const TermDictionary &dictionary) : entries_(entries), dictionary_(&dictionary) {}
+
+    Iterator begin() const { return {entries_.data(), dictionary_}; }
+    Iterator end() const { return {entries_.data() + entries_.size(), dictionary_}; }
+
+    size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+
+    /// @brief Номера слов и частоты без обращения к словарю
+    std::span<const ForwardEntry> GetEntries() const { return entries_; }
+
+private:
+    std::span<const ForwardEntry> entries_;
+    const TermDictionary *dictionary_ = nullptr;
+};
+
+/// @brief Прямой индекс: слова всех документов лежат в одном массиве, диапазон документа задаёт таблица смещений
+/// по порядковому номеру. Удалённые диапазоны освобождаются уплотнением, когда их становится много
+class ForwardIndex
+{
+public:
+    using Ordinal = DocumentAttributes::Ordinal;
+
+    /// @brief Уплотнение начинается, когда удалённые записи составляют такую долю массива
+    static constexpr size_t COMPACTION_DIVISOR = 4;
+
+    /// @param entries слова документа, отсортированные по номеру слова
+    void Add(Ordinal ordinal, std::span<const ForwardEntry> entries);
+    void Remove(Ordinal ordinal);
+
+    /// @brief Слова документа, пустой диапазон для удалённого или неизвестного документа
+    std::span<const ForwardEntry> Get(Ordinal ordinal) const;
+
+    /// @brief Приблизительный объём занятой динамической памяти
+    size_t GetMemoryUsage() const;
+
+private:
+    struct Range
+    {
+        uint64_t offset;
+        uint32_t size;
+    };
+
+    std::vector<ForwardEntry> entries_;
+    std::vector<Range> ranges_; // по порядковому номеру документа
+    size_t removed_entries_ = 0;
+
+    void Compact();
+};
+
+/// @brief Номера слов документов без частот: заменяет прямой индекс в режиме ForwardIndexMode::NONE, чтобы удаление
+/// документа затрагивало только его слова. Номера идут по возрастанию и хранятся разностями в varint, обычно 1-2 байта на слово
+class TermIdIndex
+{
+public:
+    using Ordinal = DocumentAttributes::Ordinal;
+    using TermId = TermDictionary::TermId;
+
+    /// @brief Уплотнение начинается, когда удалённые байты составляют такую долю массива
+    static constexpr size_t COMPACTION_DIVISOR = 4;
+
+    /// @param entries слова документа, отсортированные по номеру слова
+    void Add(Ordinal ordinal, std::span<const ForwardEntry> entries);
+    void Remove(Ordinal ordinal);
+
+    /// @brief Номера слов документа по возрастанию, пустой вектор для удалённого или неизвестного документа
+    std::vector<TermId> Get(Ordinal ordinal) const;
+
+    /// @brief Приблизительный объём занятой динамической памяти
+    size_t GetMemoryUsage() const;
+
+private:
+    struct Range
+    {
+        uint64_t offset;
+        uint32_t size; // в байтах
+    };
+
+    std::vector<uint8_t> bytes_;
+    std::vector<Range> ranges_; // по порядковому номеру документа
+    size_t removed_bytes_ = 0;
+
+    void Compact();
+};
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <numeric>
+#include "fuzzy_term_index.h"
+
+namespace
+{
+    // управляющие символы не встречаются в словах (см. SearchServer::IsValidWord) и отмечают края слова
+    const char WORD_BEGIN = '\x01';
+    const char WORD_END = '\x02';
+
+    /// @brief Различные биграммы слова с краями
+    std::vector<uint16_t> GetBigrams(std::string_view word)
+    {
+        std::vector<uint16_t> bigrams;
+        bigrams.reserve(word.size() + 1);
+        char previous = WORD_BEGIN;
+        for (size_t i = 0; i <= word.size(); ++i)
+        {
+            const char current = i < word.size() ? word[i] : WORD_END;
+            bigrams.push_back(static_cast<uint16_t>(static_cast<uint8_t>(previous) << 8 | static_cast<uint8_t>(current)));
+            previous = current;
+        }
+        std::sort(bigrams.begin(), bigrams.end());
+        bigrams.erase(std::unique(bigrams.begin(), bigrams.end()), bigrams.end());
+        return bigrams;
+    }
+
+    /// @brief Расстояние Левенштейна или max_distance + 1, если оно больше max_distance
+    uint32_t ComputeBoundedDistance(std::string_view lhs, std::string_view rhs, uint32_t max_distance, std::vector<uint32_t> &row)
+    {
+        row.resize(rhs.size() + 1);
+        std::iota(row.begin(), row.end(), 0u);
+        for (size_t i = 1; i <= lhs.size(); ++i)
+        {
+            uint32_t diagonal = row[0];
+            row[0] = static_cast<uint32_t>(i);
+            uint32_t row_min = row[0];
+            for (size_t j = 1; j <= rhs.size(); ++j)
+            {
+                const uint32_t above = row[j];
+                row[j] = std::min({above + 1, row[j - 1] + 1, diagonal + (lhs[i - 1] == rhs[j - 1] ? 0 : 1)});
+                diagonal = above;
+                row_min = std::min(row_min, row[j]);
+            }
+            if (row_min > max_distance)
+            {
+                return max_distance + 1;
+            }
+        }
+        return std::min(row.back(), max_distance + 1);
+    }
+}
+
+void FuzzyTermIndex::Add(TermId term, std::string_view word)
+{
+    for (const uint16_t bigram : GetBigrams(word))
+    {
+        bigram_terms_[bigram].push_back(term);
+    }
+}
+
+uint32_t FuzzyTermIndex::GetAllowedDistance(std::string_view word, uint32_t max_distance)
+{
+    if (word.size() < 3)
+    {
+        return 0;
+    }
+    return std::min({max_distance, word.size() < 6 ? 1u : 2u, MAX_DISTANCE});
+}
+
+void FuzzyTermIndex::FindSimilar(std::string_view word, uint32_t max_distance, const TermDictionary &dictionary, std::vector<FuzzyMatch> &out) const
+{
+    const uint32_t distance = GetAllowedDistance(word, max_distance);
+    if (distance == 0)
+    {
+        return;
+    }
+
+    const std::vector<uint16_t> bigrams = GetBigrams(word);
+    const size_t required = bigrams.size() > 2 * distance ? bigrams.size() - 2 * distance : 1;
+
+    // счётчики по номеру слова дешевле хэш-таблицы: словарь плотный, а обнулить его - один проход по памяти
+    std::vector<uint16_t> shared(dictionary.size());
+    std::vector<TermId> candidates;
+    for (const uint16_t bigram : bigrams)
+    {
+        const auto it = bigram_terms_.find(bigram);
+        if (it == bigram_terms_.end())
+        {
+            continue;
+        }
+        for (const TermId term : it->second)
+        {
+            if (++shared[term] == required)
+            {
+                candidates.push_back(term);
+            }
+        }
+    }
+
+    std::vector<uint32_t> row;
+    std::sort(candidates.begin(), candidates.end());
+    for (const TermId term : candidates)
+    {
+        const std::string_view candidate = dictionary.GetWord(term);
+        const size_t length_difference = candidate.size() > word.size() ? candidate.size() - word.size() : word.size() - candidate.size();
+        if (length_difference > distance)
+        {
+            continue;
+        }
+        const uint32_t candidate_distance = ComputeBoundedDistance(word, candidate, distance, row);
+        if (candidate_distance > 0 && candidate_distance <= distance)
+        {
+            out.push_back({term, candidate_distance});
+        }
+    }
+}
+
+size_t FuzzyTermIndex::GetMemoryUsage() const
+{
+    // узел unordered_map: указатель на следующий узел и пара, хэш целого ключа не хранится
+    const size_t node_size = sizeof(void *) + sizeof(std::pair<const uint16_t, std::vector<TermId>>);
+    size_t bytes = bigram_terms_.bucket_count() * sizeof(void *) + bigram_terms_.size() * node_size;
+    for (const auto &[bigram, terms] : bigram_terms_)
+    {
+        bytes += terms.capacity() * sizeof(TermId);
+    }
+    return bytes;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "term_dictionary.h"
+
+/// @brief Слово словаря, похожее на искомое
+struct FuzzyMatch
+{
+    TermDictionary::TermId term;
+    uint32_t distance; // расстояние Левенштейна до искомого слова
+};
+
+/// @brief Индекс биграмм слов словаря для поиска слов с опечатками.
+/// Правка меняет не больше двух биграмм слова, поэтому слово на расстоянии k делит с искомым
+/// не меньше (число биграмм - 2k) биграмм; точное расстояние считается только для таких кандидатов
+class FuzzyTermIndex
+{
+public:
+    using TermId = TermDictionary::TermId;
+
+    static constexpr uint32_t MAX_DISTANCE = 2;
+
+    void Add(TermId term, std::string_view word);
+
+    /// @brief Допустимое расстояние для слова: у коротких слов почти любая правка даёт другое слово
+    static uint32_t GetAllowedDistance(std::string_view word, uint32_t max_distance);
+
+    /// @brief Слова словаря на расстоянии от 1 до GetAllowedDistance(word, max_distance) в out
+    void FindSimilar(std::string_view word, uint32_t max_distance, const TermDictionary &dictionary, std::vector<FuzzyMatch> &out) const;
+
+    /// @brief Приблизительный объём занятой динамической памяти
+    size_t GetMemoryUsage() const;
+
+private:
+    std::unordered_map<uint16_t, std::vector<TermId>> bigram_terms_; // биграмма -> слова по возрастанию номера
+};
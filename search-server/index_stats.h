@@ -0,0 +1,40 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/// @brief Количество корзин гистограммы длин списков документов: корзина i содержит длины из [2^i, 2^(i+1))
+const size_t POSTING_HISTOGRAM_SIZE = 32;
+
+/// @brief Оценка памяти по структурам поискового сервера, в байтах.
+/// Для узловых контейнеров учитывается приблизительный размер узла, для векторов - ёмкость
+struct IndexMemoryStats
+{
+    size_t term_dictionary = 0; // строки слов документов
+    size_t inverted_index = 0;  // слово -> списки документов
+    size_t forward_index = 0;   // документ -> частоты слов
+    size_t positions = 0;       // позиции слов в документах
+    size_t fuzzy_terms = 0;     // биграммы слов для поиска с опечатками
+    size_t documents = 0;       // атрибуты документов и множество id
+    size_t stop_words = 0;
+
+    size_t GetTotal() const { return term_dictionary + inverted_index + forward_index + positions + fuzzy_terms + documents + stop_words; }
+};
+
+/// @brief Статистика индекса. Собирается за один проход по словарю, без обхода документов
+struct IndexStats
+{
+    IndexMemoryStats memory;
+
+    size_t document_count = 0;
+    size_t term_count = 0;    // слова, встречающиеся хотя бы в одном документе
+    size_t posting_count = 0; // пары (слово, документ)
+    double average_document_terms = 0; // среднее число различных слов в документе
+
+    std::array<size_t, POSTING_HISTOGRAM_SIZE> posting_length_histogram{};
+
+    /// @brief Самые длинные списки документов по убыванию длины
+    std::vector<std::pair<std::string_view, size_t>> largest_postings;
+};
@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <mutex>
+#include <vector>
+#include "latency_histogram.h"
+
+namespace
+{
+    using StageCounters = std::array<std::atomic<uint64_t>, LatencyHistogram::BUCKET_COUNT>;
+
+    // у каждого счётчика один писатель - свой поток, поэтому вместо fetch_add достаточно load + store
+    void Increment(std::atomic<uint64_t> &counter)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    struct ThreadHistograms;
+
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<const ThreadHistograms *> threads;
+        std::array<LatencyHistogram, LATENCY_STAGE_COUNT> retired; // гистограммы завершившихся потоков
+    };
+
+    Registry &GetRegistry()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    void MergeCounters(const StageCounters &counters, const std::atomic<uint64_t> &max, LatencyHistogram &histogram)
+    {
+        for (size_t i = 0; i < counters.size(); ++i)
+        {
+            const uint64_t count = counters[i].load(std::memory_order_relaxed);
+            if (count != 0)
+            {
+                histogram.AddToBucket(i, count);
+            }
+        }
+        histogram.UpdateMax(max.load(std::memory_order_relaxed));
+    }
+
+    struct ThreadHistograms
+    {
+        std::array<StageCounters, LATENCY_STAGE_COUNT> counters{};
+        std::array<std::atomic<uint64_t>, LATENCY_STAGE_COUNT> max{};
+
+        ThreadHistograms()
+        {
+            Registry &registry = GetRegistry();
+            std::lock_guard guard{registry.mutex};
+            registry.threads.push_back(this);
+        }
+
+        ~ThreadHistograms()
+        {
+            Registry &registry = GetRegistry();
+            std::lock_guard guard{registry.mutex};
+            for (size_t stage = 0; stage < LATENCY_STAGE_COUNT; ++stage)
+            {
+                MergeCounters(counters[stage], max[stage], registry.retired[stage]);
+            }
+            registry.threads.erase(std::find(registry.threads.begin(), registry.threads.end(), this));
+        }
+    };
+
+    ThreadHistograms &GetThreadHistograms()
+    {
+        thread_local ThreadHistograms histograms;
+        return histograms;
+    }
+}
+
+std::string_view GetLatencyStageName(LatencyStage stage)
+{
+    switch (stage)
+    {
+    case LatencyStage::QUERY_PARSE:
+        return "query_parse";
+    case LatencyStage::QUERY_SCORE:
+        return "query_score";
+    case LatencyStage::QUERY_FILTER:
+        return "query_filter";
+    case LatencyStage::QUERY_SORT:
+        return "query_sort";
+    case LatencyStage::QUERY_MATERIALIZE:
+        return "query_materialize";
+    case LatencyStage::MATCH_DOCUMENT:
+        return "match_document";
+    case LatencyStage::ADD_DOCUMENT:
+        return "add_document";
+    case LatencyStage::REMOVE_DOCUMENT:
+        return "remove_document";
+    }
+    return "unknown";
+}
+
+size_t LatencyHistogram::GetBucketIndex(uint64_t nanoseconds)
+{
+    const uint64_t value = std::min(nanoseconds, (uint64_t{1} << MAX_VALUE_BITS) - 1);
+    const size_t width = std::bit_width(value);
+    const size_t exponent = width > SUB_BUCKET_BITS + 1 ? width - SUB_BUCKET_BITS - 1 : 0;
+    return exponent * SUB_BUCKET_COUNT + static_cast<size_t>(value >> exponent);
+}
+
+uint64_t LatencyHistogram::GetBucketValue(size_t index)
+{
+    if (index < 2 * SUB_BUCKET_COUNT)
+    {
+        return index;
+    }
+    const size_t exponent = index / SUB_BUCKET_COUNT - 1;
+    const uint64_t mantissa = index - exponent * SUB_BUCKET_COUNT;
+    return (mantissa << exponent) + ((uint64_t{1} << exponent) - 1) / 2;
+}
+
+void LatencyHistogram::Record(std::chrono::nanoseconds latency)
+{
+    const uint64_t nanoseconds = std::max<int64_t>(latency.count(), 0);
+    AddToBucket(GetBucketIndex(nanoseconds), 1);
+    UpdateMax(nanoseconds);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram &other)
+{
+    for (size_t i = 0; i < BUCKET_COUNT; ++i)
+    {
+        counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+    UpdateMax(other.max_);
+}
+
+std::chrono::nanoseconds LatencyHistogram::GetPercentile(double quantile) const
+{
+    if (count_ == 0)
+    {
+        return std::chrono::nanoseconds{0};
+    }
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(std::clamp(quantile, 0.0, 1.0) * count_)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i)
+    {
+        seen += counts_[i];
+        if (seen >= rank)
+        {
+            return std::chrono::nanoseconds{std::min(GetBucketValue(i), max_)};
+        }
+    }
+    return GetMax();
+}
+
+void LatencyHistogram::AddToBucket(size_t index, uint64_t count)
+{
+    counts_[index] += count;
+    count_ += count;
+}
+
+void LatencyHistogram::UpdateMax(uint64_t max)
+{
+    max_ = std::max(max_, max);
+}
+
+void RecordLatency(LatencyStage stage, std::chrono::nanoseconds latency)
+{
+    ThreadHistograms &histograms = GetThreadHistograms();
+    const size_t stage_index = static_cast<size_t>(stage);
+    const uint64_t nanoseconds = std::max<int64_t>(latency.count(), 0);
+
+    Increment(histograms.counters[stage_index][LatencyHistogram::GetBucketIndex(nanoseconds)]);
+    std::atomic<uint64_t> &max = histograms.max[stage_index];
+    if (max.load(std::memory_order_relaxed) < nanoseconds)
+    {
+        max.store(nanoseconds, std::memory_order_relaxed);
+    }
+}
+
+LatencyHistogram GetLatencyHistogram(LatencyStage stage)
+{
+    const size_t stage_index = static_cast<size_t>(stage);
+    Registry &registry = GetRegistry();
+    std::lock_guard guard{registry.mutex};
+
+    LatencyHistogram histogram = registry.retired[stage_index];
+    for (const ThreadHistograms *thread : registry.threads)
+    {
+        MergeCounters(thread->counters[stage_index], thread->max[stage_index], histogram);
+    }
+    return histogram;
+}
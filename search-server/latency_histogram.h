@@ -0,0 +1,92 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+
+/// Гистограммы задержек по этапам поискового сервера.
+/// Запись включается макросом SEARCH_SERVER_LATENCY_HISTOGRAMS, без него LATENCY_SCOPE ничего не делает.
+/// Каждый поток пишет в свои гистограммы без блокировок, снимок сливает гистограммы всех потоков.
+
+enum class LatencyStage
+{
+    QUERY_PARSE,       // разбор запроса
+    QUERY_SCORE,       // подсчёт релевантности по индексу, включая QUERY_MATERIALIZE
+    QUERY_FILTER,      // вычисление фильтра filter:: в битовую карту кандидатов
+    QUERY_SORT,        // сортировка найденных документов
+    QUERY_MATERIALIZE, // сборка Document из накопителей релевантности
+    MATCH_DOCUMENT,
+    ADD_DOCUMENT,
+    REMOVE_DOCUMENT,
+};
+
+const size_t LATENCY_STAGE_COUNT = 8;
+
+std::string_view GetLatencyStageName(LatencyStage stage);
+
+/// @brief Гистограмма с логарифмически-линейными корзинами (как HDR Histogram):
+/// значения группируются по степени двойки, каждая степень делится на 16 корзин, относительная ошибка не больше 1/16
+class LatencyHistogram
+{
+public:
+    static constexpr size_t SUB_BUCKET_BITS = 4;
+    static constexpr size_t SUB_BUCKET_COUNT = size_t{1} << SUB_BUCKET_BITS;
+    // значения больше 2^40 нс (около 18 минут) попадают в последнюю корзину
+    static constexpr size_t MAX_VALUE_BITS = 40;
+    static constexpr size_t BUCKET_COUNT = (MAX_VALUE_BITS - SUB_BUCKET_BITS - 1) * SUB_BUCKET_COUNT + 2 * SUB_BUCKET_COUNT;
+
+    static size_t GetBucketIndex(uint64_t nanoseconds);
+    /// @brief Середина диапазона значений корзины
+    static uint64_t GetBucketValue(size_t index);
+
+    void Record(std::chrono::nanoseconds latency);
+    void Merge(const LatencyHistogram &other);
+
+    uint64_t GetCount() const { return count_; }
+    std::chrono::nanoseconds GetMax() const { return std::chrono::nanoseconds{max_}; }
+
+    /// @brief Значение, которое не превосходит доля quantile записей
+    /// @param quantile от 0 до 1, например 0.99
+    std::chrono::nanoseconds GetPercentile(double quantile) const;
+
+    /// @brief Добавить count записей в корзину index, для слияния внешних счётчиков
+    void AddToBucket(size_t index, uint64_t count);
+    void UpdateMax(uint64_t max);
+
+private:
+    std::array<uint64_t, BUCKET_COUNT> counts_{};
+    uint64_t count_ = 0;
+    uint64_t max_ = 0;
+};
+
+/// @brief Записать задержку в гистограмму этапа текущего потока
+void RecordLatency(LatencyStage stage, std::chrono::nanoseconds latency);
+
+/// @brief Снимок гистограммы этапа по всем потокам, включая завершившиеся
+LatencyHistogram GetLatencyHistogram(LatencyStage stage);
+
+class LatencyScope
+{
+public:
+    explicit LatencyScope(LatencyStage stage) : stage_(stage) {}
+    LatencyScope(const LatencyScope &) = delete;
+    LatencyScope &operator=(const LatencyScope &) = delete;
+
+    ~LatencyScope()
+    {
+        RecordLatency(stage_, std::chrono::steady_clock::now() - start_time_);
+    }
+
+private:
+    LatencyStage stage_;
+    const std::chrono::steady_clock::time_point start_time_ = std::chrono::steady_clock::now();
+};
+
+#define LATENCY_CONCAT_INTERNAL(X, Y) X##Y
+#define LATENCY_CONCAT(X, Y) LATENCY_CONCAT_INTERNAL(X, Y)
+
+#ifdef SEARCH_SERVER_LATENCY_HISTOGRAMS
+#define LATENCY_SCOPE(stage) LatencyScope LATENCY_CONCAT(latencyScope, __LINE__)(stage)
+#else
+#define LATENCY_SCOPE(stage) static_cast<void>(0)
+#endif
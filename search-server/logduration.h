@@ -14,8 +14,8 @@
 class LogDuration
 {
 public:
-    //    std::chrono::steady_clock
-    //   using  
+    // заменим имя типа std::chrono::steady_clock
+    // с помощью using для удобства
     using Clock = std::chrono::steady_clock;
 
     LogDuration() = default;
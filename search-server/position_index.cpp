@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <stdexcept>
+#include "position_index.h"
+
+namespace
+{
+    void AppendVarint(std::vector<uint8_t> &bytes, uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            bytes.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        bytes.push_back(static_cast<uint8_t>(value));
+    }
+
+    uint32_t ReadVarint(const uint8_t *&data)
+    {
+        uint32_t value = 0;
+        for (int shift = 0;; shift += 7)
+        {
+            const uint8_t byte = *data++;
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                return value;
+            }
+        }
+    }
+}
+
+void PositionIndex::Add(Ordinal ordinal, std::span<const TermPosition> positions)
+{
+    if (ordinal < ranges_.size() && ranges_[ordinal].entry_count > 0)
+        throw std::logic_error("document already has positions");
+
+    if (ordinal >= ranges_.size())
+    {
+        ranges_.resize(ordinal + 1, Range{entries_.size(), bytes_.size(), 0, 0});
+    }
+
+    Range range{entries_.size(), bytes_.size(), 0, 0};
+    for (size_t first = 0; first < positions.size();)
+    {
+        // слово: число вхождений, затем первая позиция и разности
+        size_t last = first;
+        while (last < positions.size() && positions[last].term == positions[first].term)
+        {
+            ++last;
+        }
+        entries_.push_back({positions[first].term, static_cast<uint32_t>(bytes_.size() - range.bytes_offset)});
+        AppendVarint(bytes_, static_cast<uint32_t>(last - first));
+        uint32_t previous = 0;
+        for (size_t i = first; i < last; ++i)
+        {
+            AppendVarint(bytes_, positions[i].position - previous);
+            previous = positions[i].position;
+        }
+        first = last;
+    }
+    range.entry_count = static_cast<uint32_t>(entries_.size() - range.entries_offset);
+    range.byte_count = static_cast<uint32_t>(bytes_.size() - range.bytes_offset);
+    ranges_[ordinal] = range;
+}
+
+void PositionIndex::Remove(Ordinal ordinal)
+{
+    if (ordinal >= ranges_.size())
+    {
+        return;
+    }
+    removed_bytes_ += ranges_[ordinal].byte_count + ranges_[ordinal].entry_count * sizeof(Entry);
+    ranges_[ordinal].entry_count = 0;
+    ranges_[ordinal].byte_count = 0;
+
+    if (removed_bytes_ * COMPACTION_DIVISOR > bytes_.size() + entries_.size() * sizeof(Entry))
+    {
+        Compact();
+    }
+}
+
+bool PositionIndex::GetPositions(Ordinal ordinal, TermId term, std::vector<uint32_t> &out) const
+{
+    out.clear();
+    if (ordinal >= ranges_.size())
+    {
+        return false;
+    }
+    const Range &range = ranges_[ordinal];
+    const auto first = entries_.begin() + range.entries_offset;
+    const auto last = first + range.entry_count;
+    const auto entry = std::partition_point(first, last, [term](const Entry &e)
+                                            { return e.term < term; });
+    if (entry == last || entry->term != term)
+    {
+        return false;
+    }
+
+    const uint8_t *data = bytes_.data() + range.bytes_offset + entry->offset;
+    const uint32_t count = ReadVarint(data);
+    out.resize(count);
+    uint32_t position = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        position += ReadVarint(data);
+        out[i] = position;
+    }
+    return true;
+}
+
+size_t PositionIndex::GetMemoryUsage() const
+{
+    return entries_.capacity() * sizeof(Entry) + bytes_.capacity() + ranges_.capacity() * sizeof(Range);
+}
+
+void PositionIndex::Compact()
+{
+    // смещения слов отсчитываются от начала байтов документа, поэтому переносятся без изменений
+    size_t entry_count = 0;
+    size_t byte_count = 0;
+    for (const Range &range : ranges_)
+    {
+        entry_count += range.entry_count;
+        byte_count += range.byte_count;
+    }
+    std::vector<Entry> entries;
+    std::vector<uint8_t> bytes;
+    entries.reserve(entry_count);
+    bytes.reserve(byte_count);
+    for (Range &range : ranges_)
+    {
+        const auto first_entry = entries_.begin() + range.entries_offset;
+        const auto first_byte = bytes_.begin() + range.bytes_offset;
+        range.entries_offset = entries.size();
+        range.bytes_offset = bytes.size();
+        entries.insert(entries.end(), first_entry, first_entry + range.entry_count);
+        bytes.insert(bytes.end(), first_byte, first_byte + range.byte_count);
+    }
+    entries_ = std::move(entries);
+    bytes_ = std::move(bytes);
+    removed_bytes_ = 0;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "document_attributes.h"
+#include "term_dictionary.h"
+
+/// @brief Позиция слова в документе
+struct TermPosition
+{
+    TermDictionary::TermId term;
+    uint32_t position; // номер слова в тексте документа, стоп-слова тоже занимают позиции
+};
+
+/// @brief Позиции слов документов. Для каждой пары (документ, слово) позиции хранятся разностями
+/// в формате varint (LEB128): обычно один байт на вхождение
+class PositionIndex
+{
+public:
+    using Ordinal = DocumentAttributes::Ordinal;
+    using TermId = TermDictionary::TermId;
+
+    /// @brief Уплотнение начинается, когда удалённые байты составляют такую долю массива
+    static constexpr size_t COMPACTION_DIVISOR = 4;
+
+    /// @param positions позиции слов документа, отсортированные по слову, затем по позиции
+    void Add(Ordinal ordinal, std::span<const TermPosition> positions);
+    void Remove(Ordinal ordinal);
+
+    /// @brief Позиции слова в документе по возрастанию
+    /// @return false, если слова в документе нет
+    bool GetPositions(Ordinal ordinal, TermId term, std::vector<uint32_t> &out) const;
+
+    /// @brief Приблизительный объём занятой динамической памяти
+    size_t GetMemoryUsage() const;
+
+private:
+    struct Entry
+    {
+        TermId term;
+        uint32_t offset; // начало позиций слова от начала байтов документа
+    };
+
+    struct Range
+    {
+        uint64_t entries_offset;
+        uint64_t bytes_offset;
+        uint32_t entry_count;
+        uint32_t byte_count;
+    };
+
+    std::vector<Entry> entries_;
+    std::vector<uint8_t> bytes_;
+    std::vector<Range> ranges_; // по порядковому номеру документа
+    size_t removed_bytes_ = 0;
+
+    void Compact();
+};
@@ -0,0 +1,504 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include "posting_list.h"
+
+namespace
+{
+    template <typename Quantized>
+    Quantized Quantize(double term_freq)
+    {
+        constexpr double levels = std::numeric_limits<Quantized>::max();
+        // ненулевая частота не должна превратиться в ноль
+        return static_cast<Quantized>(std::clamp(std::lround(term_freq * levels), 1l, static_cast<long>(levels)));
+    }
+
+    double Encode(double term_freq, double) { return term_freq; }
+    uint16_t Encode(double term_freq, uint16_t) { return Quantize<uint16_t>(term_freq); }
+    uint8_t Encode(double term_freq, uint8_t) { return Quantize<uint8_t>(term_freq); }
+
+    // восстановление совпадает с ScaleQuantizedTermFreqs, чтобы все пути подсчёта давали одинаковый результат
+    double Decode(double term_freq) { return term_freq; }
+    double Decode(uint16_t term_freq) { return term_freq * QUANTIZED_16_STEP; }
+    double Decode(uint8_t term_freq) { return term_freq * QUANTIZED_8_STEP; }
+
+    constexpr size_t BLOCK_SIZE = PostingList::POSTING_BLOCK_SIZE;
+    constexpr size_t MAX_BIT_WIDTH = 32;
+    // распаковка читает по 8 байт, поэтому за последним блоком держим нули
+    constexpr size_t PACKED_PADDING = sizeof(uint64_t);
+    // исключение: позиция в блоке (1 байт) и старшие разряды разности (4 байта)
+    constexpr size_t EXCEPTION_BYTES = 1 + sizeof(uint32_t);
+
+    constexpr size_t PackedBytes(size_t bit_width) { return BLOCK_SIZE * bit_width / 8; }
+
+    size_t BitLength(uint32_t value)
+    {
+        size_t length = 0;
+        while (value != 0)
+        {
+            ++length;
+            value >>= 1;
+        }
+        return length;
+    }
+
+    uint64_t LoadWord(const uint8_t *in)
+    {
+        uint64_t word;
+        std::memcpy(&word, in, sizeof(word));
+        return word;
+    }
+
+    // разрядность известна на этапе компиляции, поэтому цикл разворачивается без ветвлений
+    template <size_t Width>
+    void Unpack(const uint8_t *in, uint32_t *out)
+    {
+        constexpr uint64_t mask = (uint64_t{1} << Width) - 1;
+        for (size_t i = 0; i < BLOCK_SIZE; ++i)
+        {
+            const size_t bit = i * Width;
+            out[i] = static_cast<uint32_t>((LoadWord(in + bit / 8) >> (bit % 8)) & mask);
+        }
+    }
+
+    using UnpackFunction = void (*)(const uint8_t *, uint32_t *);
+
+    template <size_t... Widths>
+    constexpr std::array<UnpackFunction, sizeof...(Widths)> MakeUnpackTable(std::index_sequence<Widths...>)
+    {
+        return {&Unpack<Widths>...};
+    }
+
+    constexpr auto UNPACK_TABLE = MakeUnpackTable(std::make_index_sequence<MAX_BIT_WIDTH + 1>{});
+}
+
+double GetTermFreqError(TermFreqMode mode)
+{
+    switch (mode)
+    {
+    case TermFreqMode::QUANTIZED_16:
+        return QUANTIZED_16_STEP;
+    case TermFreqMode::QUANTIZED_8:
+        return QUANTIZED_8_STEP;
+    default:
+        return 0;
+    }
+}
+
+void PostingList::View::DecodeTermFreqs(size_t first, size_t count, double *out) const
+{
+    std::visit([first, count, out](const auto &term_freqs)
+               {
+                   for (size_t i = 0; i < count; ++i)
+                   {
+                       out[i] = Decode(term_freqs[first + i]);
+                   } },
+               term_freqs);
+}
+
+void PostingList::Add(Ordinal ordinal, double term_freq, TermFreqMode mode)
+{
+    if (empty() && term_freqs_.index() != static_cast<size_t>(mode))
+    {
+        switch (mode)
+        {
+        case TermFreqMode::EXACT:
+            term_freqs_.emplace<std::vector<double>>();
+            break;
+        case TermFreqMode::QUANTIZED_16:
+            term_freqs_.emplace<std::vector<uint16_t>>();
+            break;
+        case TermFreqMode::QUANTIZED_8:
+            term_freqs_.emplace<std::vector<uint8_t>>();
+            break;
+        }
+    }
+
+    const auto insert_term_freq = [this, term_freq](size_t index)
+    {
+        std::visit([index, term_freq](auto &term_freqs)
+                   { term_freqs.insert(term_freqs.begin() + index, Encode(term_freq, typename std::decay_t<decltype(term_freqs)>::value_type{})); },
+                   term_freqs_);
+    };
+
+    // новые документы получают наибольший номер, поэтому обычно это дописывание в несжатый хвост
+    const Ordinal last_ordinal = !tail_.empty() ? tail_.back() : !blocks_.empty() ? blocks_.back().last_ordinal
+                                                                                  : 0;
+    if (empty() || ordinal > last_ordinal)
+    {
+        insert_term_freq(size());
+        tail_.push_back(ordinal);
+        if (tail_.size() == POSTING_BLOCK_SIZE)
+        {
+            AppendBlock(tail_.data());
+            tail_.clear();
+        }
+        return;
+    }
+
+    const size_t block = FindBlock(ordinal);
+    std::vector<Ordinal> ordinals = DetachFrom(block);
+    const auto it = std::lower_bound(ordinals.begin(), ordinals.end(), ordinal);
+    if (it != ordinals.end() && *it == ordinal)
+    {
+        AppendOrdinals(ordinals);
+        throw std::logic_error("document is already in posting list");
+    }
+    insert_term_freq(GetTailIndex() + (it - ordinals.begin()));
+    ordinals.insert(it, ordinal);
+    AppendOrdinals(ordinals);
+}
+
+bool PostingList::Contains(Ordinal ordinal) const
+{
+    if (!tail_.empty() && ordinal >= tail_.front())
+    {
+        return std::binary_search(tail_.begin(), tail_.end(), ordinal);
+    }
+    const size_t block = FindBlock(ordinal);
+    if (block == blocks_.size() || blocks_[block].first_ordinal > ordinal)
+    {
+        return false;
+    }
+    std::array<Ordinal, POSTING_BLOCK_SIZE> decoded;
+    DecodeBlock(block, decoded.data());
+    return std::binary_search(decoded.begin(), decoded.begin() + blocks_[block].count, ordinal);
+}
+
+void PostingList::Remove(Ordinal ordinal)
+{
+    size_t index;
+    if (!tail_.empty() && ordinal >= tail_.front())
+    {
+        const auto it = std::lower_bound(tail_.begin(), tail_.end(), ordinal);
+        if (it == tail_.end() || *it != ordinal)
+        {
+            return;
+        }
+        index = GetTailIndex() + (it - tail_.begin());
+        tail_.erase(it);
+    }
+    else
+    {
+        const size_t block = FindBlock(ordinal);
+        if (block == blocks_.size() || blocks_[block].first_ordinal > ordinal)
+        {
+            return;
+        }
+        // пересжимается только этот блок, он становится неполным
+        std::array<Ordinal, POSTING_BLOCK_SIZE> decoded;
+        DecodeBlock(block, decoded.data());
+        const auto end = decoded.begin() + blocks_[block].count;
+        const auto it = std::lower_bound(decoded.begin(), end, ordinal);
+        if (it == end || *it != ordinal)
+        {
+            return;
+        }
+        index = blocks_[block].first_index + (it - decoded.begin());
+        std::copy(it + 1, end, it);
+        ReplaceBlock(block, decoded.data(), end - decoded.begin() - 1);
+    }
+    std::visit([index](auto &term_freqs)
+               { term_freqs.erase(term_freqs.begin() + index); },
+               term_freqs_);
+}
+
+PostingList::View PostingList::GetView(std::vector<Ordinal> &buffer) const
+{
+    return Slice(0, DocumentAttributes::NO_ORDINAL, buffer);
+}
+
+PostingList::View PostingList::Slice(Ordinal first, Ordinal last, std::vector<Ordinal> &buffer) const
+{
+    buffer.clear();
+    size_t block = FindBlock(first);
+    const size_t buffer_position = block < blocks_.size() ? blocks_[block].first_index : GetTailIndex();
+    for (; block < blocks_.size() && blocks_[block].first_ordinal < last; ++block)
+    {
+        const size_t decoded = buffer.size();
+        buffer.resize(decoded + POSTING_BLOCK_SIZE);
+        DecodeBlock(block, buffer.data() + decoded);
+        buffer.resize(decoded + blocks_[block].count);
+    }
+    if (block == blocks_.size())
+    {
+        buffer.insert(buffer.end(), tail_.begin(), tail_.end());
+    }
+
+    const auto begin = std::lower_bound(buffer.begin(), buffer.end(), first);
+    const auto end = std::lower_bound(begin, buffer.end(), last);
+    const size_t offset = buffer_position + (begin - buffer.begin());
+    const size_t count = end - begin;
+    return {std::span<const Ordinal>{buffer}.subspan(begin - buffer.begin(), count),
+            std::visit([offset, count](const auto &term_freqs) -> TermFreqsView
+                       { return std::span{term_freqs}.subspan(offset, count); },
+                       term_freqs_)};
+}
+
+PostingList::View PostingList::Gather(std::span<const Ordinal> ordinals, std::vector<Ordinal> &found, std::vector<double> &term_freqs) const
+{
+    found.clear();
+    term_freqs.clear();
+    Cursor cursor(*this);
+    for (const Ordinal ordinal : ordinals)
+    {
+        if (!cursor.SkipTo(ordinal))
+        {
+            break;
+        }
+        if (cursor.GetOrdinal() == ordinal)
+        {
+            found.push_back(ordinal);
+            term_freqs.push_back(cursor.GetTermFreq());
+        }
+    }
+    return {found, std::span<const double>{term_freqs}};
+}
+
+bool PostingList::Cursor::SkipTo(Ordinal ordinal)
+{
+    const std::vector<BlockHeader> &blocks = list_->blocks_;
+    if (block_ < blocks.size() && blocks[block_].last_ordinal < ordinal)
+    {
+        // галоп: шаг растёт вдвое, пока не найдётся блок, доходящий до ordinal, затем двоичный поиск
+        size_t low = block_ + 1;
+        size_t high = low;
+        for (size_t step = 1; high < blocks.size() && blocks[high].last_ordinal < ordinal; step *= 2)
+        {
+            low = high + 1;
+            high += step;
+        }
+        high = std::min(high, blocks.size());
+        block_ = std::partition_point(blocks.begin() + low, blocks.begin() + high, [ordinal](const BlockHeader &header)
+                                      { return header.last_ordinal < ordinal; }) -
+                 blocks.begin();
+        position_ = 0;
+    }
+
+    if (block_ < blocks.size())
+    {
+        if (decoded_block_ != block_)
+        {
+            list_->DecodeBlock(block_, decoded_.data());
+            decoded_block_ = block_;
+        }
+        // последний номер блока не меньше ordinal, поэтому поиск внутри блока успешен
+        position_ = std::lower_bound(decoded_.begin() + position_, decoded_.begin() + blocks[block_].count, ordinal) - decoded_.begin();
+        return true;
+    }
+
+    const std::vector<Ordinal> &tail = list_->tail_;
+    position_ = std::lower_bound(tail.begin() + std::min(position_, tail.size()), tail.end(), ordinal) - tail.begin();
+    return position_ < tail.size();
+}
+
+PostingList::Ordinal PostingList::Cursor::GetOrdinal() const
+{
+    return block_ < list_->blocks_.size() ? decoded_[position_] : list_->tail_[position_];
+}
+
+double PostingList::Cursor::GetTermFreq() const
+{
+    const std::vector<BlockHeader> &blocks = list_->blocks_;
+    const size_t index = (block_ < blocks.size() ? blocks[block_].first_index : list_->GetTailIndex()) + position_;
+    return std::visit([index](const auto &term_freqs)
+                      { return Decode(term_freqs[index]); },
+                      list_->term_freqs_);
+}
+
+size_t PostingList::GetOrdinalBytes() const
+{
+    return packed_.size() + blocks_.size() * sizeof(BlockHeader) + tail_.size() * sizeof(Ordinal);
+}
+
+size_t PostingList::GetMemoryUsage() const
+{
+    const size_t term_freq_bytes = std::visit([](const auto &term_freqs)
+                                              { return term_freqs.capacity() * sizeof(typename std::decay_t<decltype(term_freqs)>::value_type); },
+                                              term_freqs_);
+    return packed_.capacity() + blocks_.capacity() * sizeof(BlockHeader) + tail_.capacity() * sizeof(Ordinal) + term_freq_bytes;
+}
+
+PostingList::BlockHeader PostingList::EncodeBlock(const Ordinal *ordinals, size_t count, std::vector<uint8_t> &bytes)
+{
+    // разности соседних номеров минус один: номера строго возрастают, поэтому разности неотрицательны.
+    // Дополнение неполного блока - нулевые разности, разрядность они не увеличивают
+    std::array<uint32_t, BLOCK_SIZE> gaps{};
+    std::array<size_t, MAX_BIT_WIDTH + 1> length_counts{};
+    for (size_t i = 1; i < count; ++i)
+    {
+        gaps[i] = ordinals[i] - ordinals[i - 1] - 1;
+        ++length_counts[BitLength(gaps[i])];
+    }
+
+    // разрядность выбирается по наименьшему размеру блока вместе с исключениями
+    size_t bit_width = MAX_BIT_WIDTH;
+    size_t exception_count = 0;
+    size_t best_bytes = PackedBytes(MAX_BIT_WIDTH);
+    size_t wider_count = 0;
+    for (size_t width = MAX_BIT_WIDTH; width-- > 0;)
+    {
+        wider_count += length_counts[width + 1];
+        const size_t bytes = PackedBytes(width) + wider_count * EXCEPTION_BYTES;
+        if (bytes <= best_bytes)
+        {
+            best_bytes = bytes;
+            bit_width = width;
+            exception_count = wider_count;
+        }
+    }
+
+    bytes.assign(best_bytes + PACKED_PADDING, 0);
+    uint8_t *out = bytes.data();
+
+    const uint64_t mask = (uint64_t{1} << bit_width) - 1;
+    for (size_t i = 0; i < BLOCK_SIZE; ++i)
+    {
+        const size_t bit = i * bit_width;
+        const uint64_t word = LoadWord(out + bit / 8) | ((gaps[i] & mask) << (bit % 8));
+        std::memcpy(out + bit / 8, &word, sizeof(word));
+    }
+
+    uint8_t *exception = out + PackedBytes(bit_width);
+    for (size_t i = 0; i < BLOCK_SIZE && bit_width < MAX_BIT_WIDTH; ++i)
+    {
+        const uint32_t high = gaps[i] >> bit_width;
+        if (high != 0)
+        {
+            exception[0] = static_cast<uint8_t>(i);
+            std::memcpy(exception + 1, &high, sizeof(high));
+            exception += EXCEPTION_BYTES;
+        }
+    }
+    bytes.resize(best_bytes);
+
+    return {ordinals[0], ordinals[count - 1], 0, 0, static_cast<uint8_t>(count),
+            static_cast<uint8_t>(bit_width), static_cast<uint8_t>(exception_count)};
+}
+
+void PostingList::AppendBlock(const Ordinal *ordinals)
+{
+    std::vector<uint8_t> bytes;
+    BlockHeader header = EncodeBlock(ordinals, BLOCK_SIZE, bytes);
+    header.offset = static_cast<uint32_t>(packed_.empty() ? 0 : packed_.size() - PACKED_PADDING);
+    header.first_index = static_cast<uint32_t>(GetTailIndex());
+
+    packed_.resize(header.offset);
+    packed_.insert(packed_.end(), bytes.begin(), bytes.end());
+    packed_.resize(packed_.size() + PACKED_PADDING);
+    blocks_.push_back(header);
+}
+
+void PostingList::ReplaceBlock(size_t block, const Ordinal *ordinals, size_t count)
+{
+    const BlockHeader old = blocks_[block];
+    const size_t old_end = block + 1 < blocks_.size() ? blocks_[block + 1].offset : packed_.size() - PACKED_PADDING;
+    const size_t old_bytes = old_end - old.offset;
+
+    std::vector<uint8_t> bytes;
+    if (count > 0)
+    {
+        blocks_[block] = EncodeBlock(ordinals, count, bytes);
+        blocks_[block].offset = old.offset;
+        blocks_[block].first_index = old.first_index;
+    }
+
+    if (bytes.size() > old_bytes)
+    {
+        packed_.insert(packed_.begin() + old_end, bytes.size() - old_bytes, 0);
+    }
+    else
+    {
+        packed_.erase(packed_.begin() + old.offset + bytes.size(), packed_.begin() + old_end);
+    }
+    std::copy(bytes.begin(), bytes.end(), packed_.begin() + old.offset);
+
+    // следующие блоки не пересжимаются: у них меняются только смещение и номер первого документа
+    for (size_t i = block + 1; i < blocks_.size(); ++i)
+    {
+        blocks_[i].offset = static_cast<uint32_t>(blocks_[i].offset + bytes.size() - old_bytes);
+        blocks_[i].first_index -= static_cast<uint32_t>(old.count - count);
+    }
+    if (count == 0)
+    {
+        blocks_.erase(blocks_.begin() + block);
+        if (blocks_.empty())
+        {
+            packed_.clear();
+        }
+    }
+}
+
+void PostingList::DecodeBlock(size_t block, Ordinal *out) const
+{
+    const BlockHeader &header = blocks_[block];
+    const uint8_t *in = packed_.data() + header.offset;
+
+    std::array<uint32_t, BLOCK_SIZE> gaps;
+    UNPACK_TABLE[header.bit_width](in, gaps.data());
+
+    const uint8_t *exception = in + PackedBytes(header.bit_width);
+    for (size_t i = 0; i < header.exception_count; ++i, exception += EXCEPTION_BYTES)
+    {
+        uint32_t high;
+        std::memcpy(&high, exception + 1, sizeof(high));
+        gaps[exception[0]] |= high << header.bit_width;
+    }
+
+    out[0] = header.first_ordinal;
+    for (size_t i = 1; i < BLOCK_SIZE; ++i)
+    {
+        out[i] = out[i - 1] + gaps[i] + 1;
+    }
+}
+
+std::vector<PostingList::Ordinal> PostingList::DetachFrom(size_t block)
+{
+    std::vector<Ordinal> ordinals;
+    ordinals.reserve(size() - (block < blocks_.size() ? blocks_[block].first_index : GetTailIndex()) + POSTING_BLOCK_SIZE);
+    for (size_t i = block; i < blocks_.size(); ++i)
+    {
+        const size_t decoded = ordinals.size();
+        ordinals.resize(decoded + POSTING_BLOCK_SIZE);
+        DecodeBlock(i, ordinals.data() + decoded);
+        ordinals.resize(decoded + blocks_[i].count);
+    }
+    ordinals.insert(ordinals.end(), tail_.begin(), tail_.end());
+
+    if (block < blocks_.size())
+    {
+        const size_t offset = blocks_[block].offset;
+        packed_.resize(offset);
+        if (offset != 0)
+        {
+            packed_.resize(offset + PACKED_PADDING);
+        }
+        blocks_.resize(block);
+    }
+    tail_.clear();
+    return ordinals;
+}
+
+void PostingList::AppendOrdinals(const std::vector<Ordinal> &ordinals)
+{
+    for (const Ordinal ordinal : ordinals)
+    {
+        tail_.push_back(ordinal);
+        if (tail_.size() == POSTING_BLOCK_SIZE)
+        {
+            AppendBlock(tail_.data());
+            tail_.clear();
+        }
+    }
+}
+
+size_t PostingList::FindBlock(Ordinal ordinal) const
+{
+    return std::partition_point(blocks_.begin(), blocks_.end(), [ordinal](const BlockHeader &header)
+                                { return header.last_ordinal < ordinal; }) -
+           blocks_.begin();
+}
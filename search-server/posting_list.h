@@ -0,0 +1,161 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <span>
+#include <variant>
+#include <vector>
+#include "document_attributes.h"
+
+/// @brief Способ хранения частоты слова в документе
+enum class TermFreqMode
+{
+    EXACT,        // double, 8 байт
+    QUANTIZED_16, // tf * 65535, 2 байта, абсолютная ошибка tf не больше 1 / 65535
+    QUANTIZED_8,  // tf * 255, 1 байт, абсолютная ошибка tf не больше 1 / 255
+};
+
+const double QUANTIZED_16_STEP = 1.0 / 65535;
+const double QUANTIZED_8_STEP = 1.0 / 255;
+
+/// @brief Наибольшая абсолютная ошибка восстановленной частоты для режима
+double GetTermFreqError(TermFreqMode mode);
+
+/// @brief Частоты слова в одном из представлений TermFreqMode
+using TermFreqsView = std::variant<std::span<const double>, std::span<const uint16_t>, std::span<const uint8_t>>;
+
+/// @brief Список документов одного слова, упорядоченный по порядковому номеру документа.
+/// Номера документов сжаты блоками по POSTING_BLOCK_SIZE: разности соседних номеров упакованы
+/// общей для блока разрядностью (PFor), не поместившиеся разности хранятся отдельно как исключения.
+/// Заголовки блоков служат данными для пропуска: Slice распаковывает только блоки, пересекающие диапазон.
+/// Последние номера, не набравшие целый блок, лежат несжатыми. Частоты хранятся отдельным непрерывным массивом.
+/// Remove пересжимает только блок удалённого номера, поэтому блоки в середине списка могут быть неполными;
+/// Add не в конец и RemoveIf снова собирают полные блоки.
+class PostingList
+{
+public:
+    using Ordinal = DocumentAttributes::Ordinal;
+
+    static constexpr size_t POSTING_BLOCK_SIZE = 128;
+
+    struct View
+    {
+        std::span<const Ordinal> ordinals;
+        TermFreqsView term_freqs;
+
+        size_t size() const { return ordinals.size(); }
+        bool empty() const { return ordinals.empty(); }
+
+        /// @brief Восстановить частоты [first, first + count) в out
+        void DecodeTermFreqs(size_t first, size_t count, double *out) const;
+    };
+
+    /// @brief Добавить документ. Представление частот задаётся первым добавленным документом
+    void Add(Ordinal ordinal, double term_freq, TermFreqMode mode);
+    void Remove(Ordinal ordinal);
+    /// @brief Есть ли документ в списке. Распаковывается не больше одного блока
+    bool Contains(Ordinal ordinal) const;
+
+    /// @brief Удалить все документы, для которых predicate(ordinal) истинно. Список пересжимается один раз
+    /// @return сколько документов удалено
+    template <typename Predicate>
+    size_t RemoveIf(Predicate predicate);
+
+    size_t size() const { return GetTailIndex() + tail_.size(); }
+    bool empty() const { return size() == 0; }
+
+    /// @brief Весь список. Номера документов распаковываются в buffer, view действителен, пока buffer не изменён
+    View GetView(std::vector<Ordinal> &buffer) const;
+
+    /// @brief Часть списка с порядковыми номерами из [first, last). Номера распаковываются в buffer
+    View Slice(Ordinal first, Ordinal last, std::vector<Ordinal> &buffer) const;
+
+    /// @brief Документы из ordinals (по возрастанию), которые есть в списке. Список читается курсором с пропуском,
+    /// частоты восстанавливаются в term_freqs. View действителен, пока found и term_freqs не изменены
+    View Gather(std::span<const Ordinal> ordinals, std::vector<Ordinal> &found, std::vector<double> &term_freqs) const;
+
+    /// @brief Последовательный обход с пропуском: SkipTo ищет блок галопом по заголовкам и распаковывает только его
+    class Cursor
+    {
+    public:
+        explicit Cursor(const PostingList &list) : list_(&list) {}
+
+        /// @brief Перейти к первому номеру не меньше ordinal. Курсор не возвращается назад
+        /// @return false, если таких номеров в списке нет
+        bool SkipTo(Ordinal ordinal);
+
+        /// @brief Текущий номер, действителен после успешного SkipTo
+        Ordinal GetOrdinal() const;
+        double GetTermFreq() const;
+
+    private:
+        const PostingList *list_;
+        size_t block_ = 0;    // текущий блок, blocks_.size() - несжатый хвост
+        size_t position_ = 0; // позиция в блоке или хвосте
+        size_t decoded_block_ = SIZE_MAX;
+        std::array<Ordinal, POSTING_BLOCK_SIZE> decoded_;
+    };
+
+    /// @brief Объём памяти, занимаемый номерами документов (сжатые блоки, заголовки и несжатый хвост)
+    size_t GetOrdinalBytes() const;
+
+    /// @brief Объём занятой списком динамической памяти, включая частоты и резерв векторов
+    size_t GetMemoryUsage() const;
+
+private:
+    struct BlockHeader
+    {
+        Ordinal first_ordinal;
+        Ordinal last_ordinal;
+        uint32_t offset;         // начало блока в packed_
+        uint32_t first_index;    // номер первого документа блока в списке и в частотах
+        uint8_t count;           // документов в блоке, меньше POSTING_BLOCK_SIZE после Remove
+        uint8_t bit_width;       // разрядность упакованных разностей
+        uint8_t exception_count; // исключения лежат в packed_ сразу за упакованными разностями
+    };
+
+    std::vector<BlockHeader> blocks_;
+    std::vector<uint8_t> packed_;
+    std::vector<Ordinal> tail_;
+    std::variant<std::vector<double>, std::vector<uint16_t>, std::vector<uint8_t>> term_freqs_;
+
+    /// @brief Сжать count номеров в bytes. Неполный блок дополняется номерами подряд за последним
+    static BlockHeader EncodeBlock(const Ordinal *ordinals, size_t count, std::vector<uint8_t> &bytes);
+    /// @brief Сжать POSTING_BLOCK_SIZE номеров и добавить блок в конец
+    void AppendBlock(const Ordinal *ordinals);
+    /// @brief Пересжать блок из count номеров, сдвинув байты и номера документов следующих блоков. При count = 0 блок удаляется
+    void ReplaceBlock(size_t block, const Ordinal *ordinals, size_t count);
+    /// @brief Распаковать блок в out (POSTING_BLOCK_SIZE номеров, за count номерами блока - дополнение)
+    void DecodeBlock(size_t block, Ordinal *out) const;
+    /// @brief Номер первого документа несжатого хвоста
+    size_t GetTailIndex() const { return blocks_.empty() ? 0 : blocks_.back().first_index + blocks_.back().count; }
+    /// @brief Распаковать номера начиная с блока block, отбросив этот и последующие блоки
+    std::vector<Ordinal> DetachFrom(size_t block);
+    /// @brief Дописать номера в конец, сжимая полные блоки
+    void AppendOrdinals(const std::vector<Ordinal> &ordinals);
+    /// @brief Первый блок, последний номер которого не меньше ordinal
+    size_t FindBlock(Ordinal ordinal) const;
+};
+
+template <typename Predicate>
+size_t PostingList::RemoveIf(Predicate predicate)
+{
+    std::vector<Ordinal> ordinals = DetachFrom(0);
+    size_t kept = 0;
+    std::visit([&](auto &term_freqs)
+               {
+                   for (size_t i = 0; i < ordinals.size(); ++i)
+                   {
+                       if (!predicate(ordinals[i]))
+                       {
+                           ordinals[kept] = ordinals[i];
+                           term_freqs[kept] = term_freqs[i];
+                           ++kept;
+                       }
+                   }
+                   term_freqs.resize(kept); },
+               term_freqs_);
+    const size_t removed = ordinals.size() - kept;
+    ordinals.resize(kept);
+    AppendOrdinals(ordinals);
+    return removed;
+}
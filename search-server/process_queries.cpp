@@ -1,36 +1,50 @@
 #include "process_queries.h"
 #include <algorithm>
 #include <execution>
+#include <numeric>
+#include <thread>
 
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer &search_server,
     const std::vector<std::string> &queries)
 
 {
-    std::vector<std::vector<Document>> result(queries.size());
-    std::transform(std::execution::par,
-                   queries.begin(), queries.end(),
-                   result.begin(),
-                   [&search_server](const auto &query)
-                   { return search_server.FindTopDocuments(query); });
-    return result;
+    return search_server.FindTopDocumentsBatch(queries);
 }
 
 std::vector<Document> ProcessQueriesJoined(
     const SearchServer &search_server,
     const std::vector<std::string> &queries)
 {
-    return std::transform_reduce(
-        std::execution::par,
-        queries.begin(), queries.end(),
-        std::vector<Document>(),
-        [](std::vector<Document> lhs, std::vector<Document> rhs)
-        {
-            lhs.insert(lhs.end(), rhs.begin(), rhs.end());
-            return lhs;
-        },
-        [&search_server](const auto &query)
+    const std::vector<std::vector<Document>> results = search_server.FindTopDocumentsBatch(queries);
+
+    std::vector<size_t> offsets(results.size() + 1, 0);
+    std::transform_inclusive_scan(results.begin(), results.end(), offsets.begin() + 1, std::plus<>{},
+                                  [](const std::vector<Document> &documents)
+                                  { return documents.size(); });
+
+    std::vector<Document> joined(offsets.back());
+    ParallelForEach(std::execution::par, results.size(),
+                    [&](size_t i)
+                    { std::copy(results[i].begin(), results[i].end(), joined.begin() + offsets[i]); });
+    return joined;
+}
+
+void ProcessQueriesStreaming(
+    const SearchServer &search_server,
+    const std::vector<std::string> &queries,
+    const QueryResultConsumer &consumer)
+{
+    // группа достаточно велика, чтобы пакетный поиск занял все потоки
+    const size_t group_size = MAX_BATCH_CHUNK_SIZE * std::max(1u, std::thread::hardware_concurrency());
+    const std::span<const std::string> all_queries{queries};
+    for (size_t first = 0; first < queries.size(); first += group_size)
+    {
+        const size_t count = std::min(group_size, queries.size() - first);
+        const std::vector<std::vector<Document>> results = search_server.FindTopDocumentsBatch(all_queries.subspan(first, count));
+        for (size_t i = 0; i < count; ++i)
         {
-            return search_server.FindTopDocuments(query);
-        });
-}
\ No newline at end of file
+            consumer(first + i, results[i]);
+        }
+    }
+}
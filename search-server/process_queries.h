@@ -1,5 +1,7 @@
 #pragma once
 
+#include <functional>
+#include <span>
 #include <vector>
 #include <string>
 #include "document.h"
@@ -9,6 +11,18 @@ std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer &search_server,
     const std::vector<std::string> &queries);
 
+/// @brief Результаты всех запросов подряд в одном буфере.
+/// Размер буфера и смещения запросов считаются по количеству найденных документов, затем буфер заполняется параллельно
 std::vector<Document> ProcessQueriesJoined(
     const SearchServer &search_server,
     const std::vector<std::string> &queries);
+
+/// @brief Обработчик результата одного запроса: номер запроса и найденные документы
+using QueryResultConsumer = std::function<void(size_t query_index, std::span<const Document> documents)>;
+
+/// @brief Потоковая обработка: запросы считаются группами, результаты каждой группы передаются consumer
+/// в порядке запросов из вызывающего потока и после этого освобождаются, весь пакет целиком не хранится
+void ProcessQueriesStreaming(
+    const SearchServer &search_server,
+    const std::vector<std::string> &queries,
+    const QueryResultConsumer &consumer);
@@ -0,0 +1,114 @@
+#include "relevance_accumulator.h"
+#include "scoring_kernel.h"
+
+void ScaleTermFreqs(TermFreqsView term_freqs, double inverse_document_freq, double *out)
+{
+    std::visit([inverse_document_freq, out](const auto &freqs)
+               {
+                   using Value = typename std::decay_t<decltype(freqs)>::value_type;
+                   if constexpr (std::is_same_v<Value, double>)
+                   {
+                       ScaleTermFreqs(freqs.data(), freqs.size(), inverse_document_freq, out);
+                   }
+                   else
+                   {
+                       const double step = std::is_same_v<Value, uint16_t> ? QUANTIZED_16_STEP : QUANTIZED_8_STEP;
+                       ScaleQuantizedTermFreqs(freqs.data(), freqs.size(), step, inverse_document_freq, out);
+                   } },
+               term_freqs);
+}
+
+void RelevanceAccumulator::MergeAdd(std::span<const Ordinal> ordinals, TermFreqsView term_freqs, double inverse_document_freq)
+{
+    scaled_.resize(ordinals.size());
+    ScaleTermFreqs(term_freqs, inverse_document_freq, scaled_.data());
+    MergeAddScaled(ordinals, scaled_);
+}
+
+void RelevanceAccumulator::MergeAddScaled(std::span<const Ordinal> ordinals, std::span<const double> relevances)
+{
+    if (ordinals_.empty())
+    {
+        ordinals_.assign(ordinals.begin(), ordinals.end());
+        relevances_.assign(relevances.begin(), relevances.end());
+        return;
+    }
+
+    merged_ordinals_.clear();
+    merged_relevances_.clear();
+    merged_ordinals_.reserve(ordinals_.size() + ordinals.size());
+    merged_relevances_.reserve(ordinals_.size() + ordinals.size());
+
+    size_t lhs = 0;
+    size_t rhs = 0;
+    while (lhs < ordinals_.size() && rhs < ordinals.size())
+    {
+        if (ordinals_[lhs] < ordinals[rhs])
+        {
+            merged_ordinals_.push_back(ordinals_[lhs]);
+            merged_relevances_.push_back(relevances_[lhs++]);
+        }
+        else if (ordinals[rhs] < ordinals_[lhs])
+        {
+            merged_ordinals_.push_back(ordinals[rhs]);
+            merged_relevances_.push_back(relevances[rhs++]);
+        }
+        else
+        {
+            merged_ordinals_.push_back(ordinals_[lhs]);
+            merged_relevances_.push_back(relevances_[lhs++] + relevances[rhs++]);
+        }
+    }
+    merged_ordinals_.insert(merged_ordinals_.end(), ordinals_.begin() + lhs, ordinals_.end());
+    merged_relevances_.insert(merged_relevances_.end(), relevances_.begin() + lhs, relevances_.end());
+    merged_ordinals_.insert(merged_ordinals_.end(), ordinals.begin() + rhs, ordinals.end());
+    merged_relevances_.insert(merged_relevances_.end(), relevances.begin() + rhs, relevances.end());
+
+    ordinals_.swap(merged_ordinals_);
+    relevances_.swap(merged_relevances_);
+}
+
+void RelevanceAccumulator::Exclude(std::span<const Ordinal> ordinals)
+{
+    size_t out = 0;
+    size_t excluded = 0;
+    for (size_t i = 0; i < ordinals_.size(); ++i)
+    {
+        while (excluded < ordinals.size() && ordinals[excluded] < ordinals_[i])
+        {
+            ++excluded;
+        }
+        if (excluded < ordinals.size() && ordinals[excluded] == ordinals_[i])
+        {
+            continue;
+        }
+        ordinals_[out] = ordinals_[i];
+        relevances_[out] = relevances_[i];
+        ++out;
+    }
+    ordinals_.resize(out);
+    relevances_.resize(out);
+}
+
+void RelevanceAccumulator::Exclude(const DocumentSet &excluded)
+{
+    // документы между исключёнными сдвигаются к началу
+    size_t out = 0;
+    size_t next = 0;
+    const auto keep_until = [this, &out, &next](size_t end)
+    {
+        for (; next < end; ++next, ++out)
+        {
+            ordinals_[out] = ordinals_[next];
+            relevances_[out] = relevances_[next];
+        }
+    };
+    excluded.IntersectSorted(ordinals_, [&keep_until, &next](size_t i)
+                             {
+                                 keep_until(i);
+                                 next = i + 1;
+                             });
+    keep_until(ordinals_.size());
+    ordinals_.resize(out);
+    relevances_.resize(out);
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <span>
+#include <vector>
+#include "document_attributes.h"
+#include "document_set.h"
+#include "posting_list.h"
+
+/// @brief Накопитель релевантности, упорядоченный по порядковому номеру документа.
+/// Списки документов слов сливаются в него целиком: сначала блок частот умножается на idf
+/// ядром ScaleTermFreqs (или ScaleQuantizedTermFreqs), затем результат слиянием добавляется к накопленному.
+/// Порядок сложений для каждого документа совпадает с порядком вызовов MergeAdd.
+class RelevanceAccumulator
+{
+public:
+    using Ordinal = DocumentAttributes::Ordinal;
+
+    /// @brief Добавить вклад слова. ordinals упорядочены по возрастанию
+    void MergeAdd(std::span<const Ordinal> ordinals, TermFreqsView term_freqs, double inverse_document_freq);
+
+    /// @brief Добавить уже умноженные на idf вклады, например общие для нескольких запросов пакета
+    void MergeAddScaled(std::span<const Ordinal> ordinals, std::span<const double> relevances);
+
+    /// @brief Исключить документы. ordinals упорядочены по возрастанию
+    void Exclude(std::span<const Ordinal> ordinals);
+    /// @brief Исключить документы множества
+    void Exclude(const DocumentSet &excluded);
+
+    size_t size() const { return ordinals_.size(); }
+    std::span<const Ordinal> GetOrdinals() const { return ordinals_; }
+    std::span<const double> GetRelevances() const { return relevances_; }
+
+private:
+    std::vector<Ordinal> ordinals_;
+    std::vector<double> relevances_;
+
+    // буферы переиспользуются между вызовами
+    std::vector<double> scaled_;
+    std::vector<Ordinal> merged_ordinals_;
+    std::vector<double> merged_relevances_;
+};
+
+/// @brief out[i] = term_freqs[i] * inverse_document_freq ядром, подходящим представлению частот
+void ScaleTermFreqs(TermFreqsView term_freqs, double inverse_document_freq, double *out);
@@ -1,32 +1,23 @@
 #include "remove_duplicates.h"
-#include <iterator>
-
-template <typename Key, typename Value>
-std::set<Key> ExtractKeysFromMap(const std::map<Key, Value> &container)
-{
-    std::set<Key> out;
-
-    std::transform(container.begin(), container.end(),
-                   std::insert_iterator(out, out.begin()),
-                   [](const auto &key_value)
-                   {
-                       return key_value.first;
-                   });
-
-    return out;
-}
+#include <algorithm>
+#include <iostream>
 
 void RemoveDuplicates(SearchServer &search_server)
 {
-    std::set<int> duplicate_for_remove;
+    DocumentSet duplicate_for_remove;
 
-    std::set<std::set<std::string_view>> verified;
+    // слова документа в прямом индексе уже отсортированы по номеру, поэтому набор слов сравнивается как вектор номеров
+    std::set<std::vector<TermDictionary::TermId>> verified;
 
     for (const int document_id : search_server)
     {
-        std::set<std::string_view> wordsOfDocument = ExtractKeysFromMap(
-            search_server.GetWordFrequencies(
-                document_id));
+        const std::span<const ForwardEntry> entries = search_server.GetWordFrequencies(document_id).GetEntries();
+        std::vector<TermDictionary::TermId> wordsOfDocument(entries.size());
+        std::transform(entries.begin(), entries.end(), wordsOfDocument.begin(),
+                       [](const ForwardEntry &entry)
+                       {
+                           return entry.term;
+                       });
 
         if (0 == verified.count(wordsOfDocument))
         {
@@ -34,7 +25,7 @@ void RemoveDuplicates(SearchServer &search_server)
             continue;
         }
 
-        duplicate_for_remove.insert(document_id);
+        duplicate_for_remove.Add(document_id);
     }
 
     for (const int id : duplicate_for_remove)
@@ -2,6 +2,6 @@
 
 #include "search_server.h"
 
-/// @brief     
+/// @brief Функция поиска и удаления дубликатов
 /// @param search_server
 void RemoveDuplicates(SearchServer &search_server);
\ No newline at end of file
@@ -1,44 +1,109 @@
 #include "request_queue.h"
 
 RequestQueue::RequestQueue(const SearchServer &search_server)
-    : search_server_(search_server), no_results_requests_(0), current_time_(0)
+    : search_server_(search_server)
+{
+}
+
+RequestQueue::RequestQueue(const SearchServer &search_server, MinuteClock minute_clock)
+    : search_server_(search_server), minute_clock_(std::move(minute_clock))
 {
 }
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string &raw_query, DocumentStatus status)
 {
+    const auto start = Clock::now();
     const auto result = search_server_.FindTopDocuments(raw_query, status);
-    AddRequest(result.size());
+    AddRequest(result.size(), Clock::now() - start);
     return result;
 }
 std::vector<Document> RequestQueue::AddFindRequest(const std::string &raw_query)
 {
+    const auto start = Clock::now();
     const auto result = search_server_.FindTopDocuments(raw_query);
-    AddRequest(result.size());
+    AddRequest(result.size(), Clock::now() - start);
     return result;
 }
 int RequestQueue::GetNoResultRequests() const
 {
-    return no_results_requests_;
+    return static_cast<int>(GetStats().no_result_requests);
 }
 
-void RequestQueue::AddRequest(int results_num)
+RequestStats RequestQueue::GetStats() const
 {
-    //   -  
-    ++current_time_;
-    //    ,  
-    while (!requests_.empty() && min_in_day_ <= current_time_ - requests_.front().timestamp)
+    const uint64_t current = current_time_.load(std::memory_order_acquire);
+    RequestStats stats;
+    for (uint64_t index = 0; index < min_in_day_ && index <= current; ++index)
+    {
+        // в корзину попадает единственная минута окна (current - min_in_day_, current]; счётчики, уже
+        // перезаписанные более новой минутой или ещё хранящие старую, помечены другим кругом и не учитываются
+        const uint64_t minute = current - (current - index) % min_in_day_;
+        const uint64_t lap = minute / min_in_day_;
+        const Bucket &bucket = buckets_[index];
+        stats.requests += ReadCounter(bucket.requests, lap);
+        stats.no_result_requests += ReadCounter(bucket.no_result_requests, lap);
+        stats.total_latency += std::chrono::microseconds{ReadCounter(bucket.latency_us, lap)};
+    }
+    return stats;
+}
+
+uint64_t RequestQueue::GetSteadyClockMinute()
+{
+    return std::chrono::duration_cast<std::chrono::minutes>(Clock::now().time_since_epoch()).count();
+}
+
+uint64_t RequestQueue::NextMinute()
+{
+    if (!minute_clock_)
+    {
+        // новый запрос - новая минута
+        return current_time_.fetch_add(1, std::memory_order_acq_rel) + 1;
+    }
+
+    const uint64_t minute = minute_clock_();
+    uint64_t current = current_time_.load(std::memory_order_relaxed);
+    while (current < minute && !current_time_.compare_exchange_weak(current, minute, std::memory_order_acq_rel))
     {
-        if (0 == requests_.front().results)
-        {
-            --no_results_requests_;
-        }
-        requests_.pop_front();
     }
-    //    
-    requests_.push_back({current_time_, results_num});
+    return minute;
+}
+
+void RequestQueue::AddRequest(size_t results_num, Clock::duration latency)
+{
+    const uint64_t minute = NextMinute();
+    Bucket &bucket = buckets_[minute % min_in_day_];
+    const uint64_t lap = minute / min_in_day_;
+
+    AddToCounter(bucket.requests, lap, 1);
     if (0 == results_num)
     {
-        ++no_results_requests_;
+        AddToCounter(bucket.no_result_requests, lap, 1);
+    }
+    AddToCounter(bucket.latency_us, lap, std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+}
+
+void RequestQueue::AddToCounter(std::atomic<uint64_t> &counter, uint64_t lap, uint64_t value)
+{
+    const uint64_t tag = lap << VALUE_BITS;
+    uint64_t stored = counter.load(std::memory_order_relaxed);
+    while (true)
+    {
+        // разность кругов по модулю 2^LAP_BITS: отрицательная - счётчик уже отдан более новой минуте, запрос выпал из окна
+        const int64_t age = static_cast<int64_t>(tag - (stored & ~VALUE_MASK)) >> VALUE_BITS;
+        if (age < 0)
+        {
+            return;
+        }
+        const uint64_t base = age == 0 ? stored : tag;
+        if (counter.compare_exchange_weak(stored, base + value, std::memory_order_relaxed))
+        {
+            return;
+        }
     }
 }
+
+uint64_t RequestQueue::ReadCounter(const std::atomic<uint64_t> &counter, uint64_t lap)
+{
+    const uint64_t stored = counter.load(std::memory_order_relaxed);
+    return (stored & ~VALUE_MASK) == lap << VALUE_BITS ? stored & VALUE_MASK : 0;
+}
@@ -1,41 +1,85 @@
 #pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <functional>
 #include <string>
 #include <vector>
-#include <deque>
-#include <cstdint>
 #include "search_server.h"
 #include "document.h"
 
+/// @brief Статистика запросов за скользящее окно
+struct RequestStats
+{
+    uint64_t requests = 0;
+    uint64_t no_result_requests = 0;
+    std::chrono::microseconds total_latency{0};
+
+    std::chrono::microseconds GetAverageLatency() const
+    {
+        return requests == 0 ? std::chrono::microseconds{0} : total_latency / static_cast<int64_t>(requests);
+    }
+};
+
+/// @brief Учёт запросов за последние min_in_day_ минут.
+/// Минуты лежат в кольцевом буфере корзин с атомарными счётчиками, поэтому одну очередь
+/// можно разделять между потоками. Каждый счётчик помечен кругом своей минуты, так что запись
+/// никого не ждёт: счётчик прошлого круга перезаписывается одной CAS, а не обнуляется заранее.
 class RequestQueue
 {
 public:
+    /// @brief Источник текущей минуты. Должен быть неубывающим
+    using MinuteClock = std::function<uint64_t()>;
+
+    /// @brief Каждый запрос считается новой минутой
     explicit RequestQueue(const SearchServer &search_server);
+    RequestQueue(const SearchServer &search_server, MinuteClock minute_clock);
+
     template <typename DocumentPredicate>
     std::vector<Document> AddFindRequest(const std::string &raw_query, DocumentPredicate document_predicate);
     std::vector<Document> AddFindRequest(const std::string &raw_query, DocumentStatus status);
     std::vector<Document> AddFindRequest(const std::string &raw_query);
     int GetNoResultRequests() const;
 
+    RequestStats GetStats() const;
+
+    /// @brief Минуты std::chrono::steady_clock
+    static uint64_t GetSteadyClockMinute();
+
 private:
-    struct QueryResult
+    using Clock = std::chrono::steady_clock;
+
+    const static int min_in_day_ = 1440;
+    // в старших LAP_BITS битах счётчика - круг минуты (минута / min_in_day_) по модулю 2^LAP_BITS,
+    // в остальных - значение, не больше 2^VALUE_BITS за минуту
+    static constexpr int LAP_BITS = 24;
+    static constexpr int VALUE_BITS = 64 - LAP_BITS;
+    static constexpr uint64_t VALUE_MASK = (uint64_t{1} << VALUE_BITS) - 1;
+
+    struct Bucket
     {
-        uint64_t timestamp;
-        int results;
+        std::atomic<uint64_t> requests{0};
+        std::atomic<uint64_t> no_result_requests{0};
+        std::atomic<uint64_t> latency_us{0};
     };
-    std::deque<QueryResult> requests_;
+
     const SearchServer &search_server_;
-    int no_results_requests_;
-    uint64_t current_time_;
-    const static int min_in_day_ = 1440;
+    MinuteClock minute_clock_;
+    std::atomic<uint64_t> current_time_{0};
+    std::array<Bucket, min_in_day_> buckets_;
 
-    void AddRequest(int results_num);
+    uint64_t NextMinute();
+    void AddRequest(size_t results_num, Clock::duration latency);
+    static void AddToCounter(std::atomic<uint64_t> &counter, uint64_t lap, uint64_t value);
+    static uint64_t ReadCounter(const std::atomic<uint64_t> &counter, uint64_t lap);
 };
 
 template <typename DocumentPredicate>
 std::vector<Document> RequestQueue::AddFindRequest(const std::string &raw_query, DocumentPredicate document_predicate)
 {
+    const auto start = Clock::now();
     const auto result = search_server_.FindTopDocuments(raw_query, document_predicate);
-    AddRequest(result.size());
+    AddRequest(result.size(), Clock::now() - start);
     return result;
 }
@@ -0,0 +1,88 @@
+#include <functional>
+#include "result_cache.h"
+
+ResultCache::ResultCache(size_t capacity)
+    : capacity_(capacity),
+      shard_capacity_((capacity + RESULT_CACHE_SHARD_COUNT - 1) / RESULT_CACHE_SHARD_COUNT),
+      shards_(capacity > 0 ? RESULT_CACHE_SHARD_COUNT : 0)
+{
+}
+
+ResultCache &ResultCache::operator=(const ResultCache &other)
+{
+    if (this != &other)
+    {
+        capacity_ = other.capacity_;
+        shard_capacity_ = other.shard_capacity_;
+        shards_ = std::vector<Shard>(other.shards_.size());
+        hits_ = 0;
+        misses_ = 0;
+    }
+    return *this;
+}
+
+std::optional<std::vector<Document>> ResultCache::Find(const std::string &key, uint64_t generation)
+{
+    Shard &shard = GetShard(key);
+    std::lock_guard guard{shard.mutex};
+
+    const auto it = shard.index.find(key);
+    if (it == shard.index.end())
+    {
+        ++misses_;
+        return std::nullopt;
+    }
+    if (it->second->generation != generation)
+    {
+        // индекс изменился после вычисления результата
+        const auto entry = it->second;
+        shard.index.erase(it);
+        shard.entries.erase(entry);
+        ++misses_;
+        return std::nullopt;
+    }
+
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    ++hits_;
+    return it->second->documents;
+}
+
+void ResultCache::Insert(const std::string &key, uint64_t generation, const std::vector<Document> &documents)
+{
+    Shard &shard = GetShard(key);
+    std::lock_guard guard{shard.mutex};
+
+    // параллельный читатель мог успеть вставить тот же ключ
+    const auto it = shard.index.find(key);
+    if (it != shard.index.end())
+    {
+        it->second->generation = generation;
+        it->second->documents = documents;
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        return;
+    }
+
+    if (shard.entries.size() >= shard_capacity_)
+    {
+        shard.index.erase(shard.entries.back().key);
+        shard.entries.pop_back();
+    }
+    shard.entries.push_front({key, generation, documents});
+    shard.index.emplace(shard.entries.front().key, shard.entries.begin());
+}
+
+ResultCacheStats ResultCache::GetStats() const
+{
+    ResultCacheStats stats{hits_, misses_, 0};
+    for (const Shard &shard : shards_)
+    {
+        std::lock_guard guard{shard.mutex};
+        stats.size += shard.entries.size();
+    }
+    return stats;
+}
+
+ResultCache::Shard &ResultCache::GetShard(const std::string &key)
+{
+    return shards_[std::hash<std::string>{}(key) % shards_.size()];
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "document.h"
+
+const size_t RESULT_CACHE_SHARD_COUNT = 16;
+
+struct ResultCacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    size_t size = 0;
+};
+
+/// @brief Кэш результатов поиска с вытеснением давно не использованных записей (LRU).
+/// Записи помечаются поколением индекса: запись другого поколения считается промахом и удаляется.
+/// Кэш разбит на шарды со своими мьютексами, поэтому параллельные читатели редко ждут друг друга.
+/// Копия кэша получает ту же ёмкость, но пустое содержимое.
+class ResultCache
+{
+public:
+    /// @param capacity наибольшее число записей, 0 - кэш выключен
+    explicit ResultCache(size_t capacity = 0);
+    ResultCache(const ResultCache &other) : ResultCache(other.capacity_) {}
+    ResultCache &operator=(const ResultCache &other);
+
+    bool IsEnabled() const { return capacity_ > 0; }
+
+    std::optional<std::vector<Document>> Find(const std::string &key, uint64_t generation);
+    void Insert(const std::string &key, uint64_t generation, const std::vector<Document> &documents);
+
+    ResultCacheStats GetStats() const;
+
+private:
+    struct Entry
+    {
+        std::string key;
+        uint64_t generation;
+        std::vector<Document> documents;
+    };
+
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        std::list<Entry> entries; // от недавно использованных к давно не использованным
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> index; // ключи ссылаются на строки в entries
+    };
+
+    size_t capacity_;
+    size_t shard_capacity_;
+    std::vector<Shard> shards_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+
+    Shard &GetShard(const std::string &key);
+};
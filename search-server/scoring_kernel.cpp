@@ -0,0 +1,233 @@
+#include <atomic>
+#include <cstring>
+#include "scoring_kernel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SCORING_KERNEL_X86
+#define SCORING_TARGET(isa) __attribute__((target(isa)))
+#elif defined(_MSC_VER) && defined(_M_X64)
+#include <immintrin.h>
+#include <intrin.h>
+#define SCORING_KERNEL_X86
+#define SCORING_TARGET(isa)
+#endif
+
+namespace
+{
+    void ScaleScalar(const double *term_freqs, size_t count, double inverse_document_freq, double *out)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i] = term_freqs[i] * inverse_document_freq;
+        }
+    }
+
+    template <typename Quantized>
+    void ScaleQuantizedScalar(const Quantized *quantized, size_t count, double step, double inverse_document_freq, double *out)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i] = (quantized[i] * step) * inverse_document_freq;
+        }
+    }
+
+#ifdef SCORING_KERNEL_X86
+    SCORING_TARGET("avx2")
+    void ScaleAvx2(const double *term_freqs, size_t count, double inverse_document_freq, double *out)
+    {
+        const __m256d idf = _mm256_set1_pd(inverse_document_freq);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(term_freqs + i), idf));
+        }
+        ScaleScalar(term_freqs + i, count - i, inverse_document_freq, out + i);
+    }
+
+    SCORING_TARGET("avx2")
+    void ScaleQuantizedAvx2(const uint16_t *quantized, size_t count, double step, double inverse_document_freq, double *out)
+    {
+        const __m256d step_pd = _mm256_set1_pd(step);
+        const __m256d idf = _mm256_set1_pd(inverse_document_freq);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m128i words = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(quantized + i));
+            const __m256d values = _mm256_cvtepi32_pd(_mm_cvtepu16_epi32(words));
+            _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_mul_pd(values, step_pd), idf));
+        }
+        ScaleQuantizedScalar(quantized + i, count - i, step, inverse_document_freq, out + i);
+    }
+
+    SCORING_TARGET("avx2")
+    void ScaleQuantizedAvx2(const uint8_t *quantized, size_t count, double step, double inverse_document_freq, double *out)
+    {
+        const __m256d step_pd = _mm256_set1_pd(step);
+        const __m256d idf = _mm256_set1_pd(inverse_document_freq);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            int32_t packed;
+            std::memcpy(&packed, quantized + i, sizeof(packed));
+            const __m256d values = _mm256_cvtepi32_pd(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed)));
+            _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_mul_pd(values, step_pd), idf));
+        }
+        ScaleQuantizedScalar(quantized + i, count - i, step, inverse_document_freq, out + i);
+    }
+
+    SCORING_TARGET("avx512f")
+    void ScaleAvx512(const double *term_freqs, size_t count, double inverse_document_freq, double *out)
+    {
+        const __m512d idf = _mm512_set1_pd(inverse_document_freq);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            _mm512_storeu_pd(out + i, _mm512_mul_pd(_mm512_loadu_pd(term_freqs + i), idf));
+        }
+        ScaleScalar(term_freqs + i, count - i, inverse_document_freq, out + i);
+    }
+
+    // _mm512_cvtepi32_pd в GCC берёт неинициализированный регистр-заготовку и даёт -Wmaybe-uninitialized,
+    // maskz-вариант с полной маской - та же инструкция с обнулённой заготовкой
+    SCORING_TARGET("avx512f")
+    void ScaleQuantizedAvx512(const uint16_t *quantized, size_t count, double step, double inverse_document_freq, double *out)
+    {
+        const __m512d step_pd = _mm512_set1_pd(step);
+        const __m512d idf = _mm512_set1_pd(inverse_document_freq);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            const __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i *>(quantized + i));
+            const __m512d values = _mm512_maskz_cvtepi32_pd(0xFF, _mm256_cvtepu16_epi32(words));
+            _mm512_storeu_pd(out + i, _mm512_mul_pd(_mm512_mul_pd(values, step_pd), idf));
+        }
+        ScaleQuantizedScalar(quantized + i, count - i, step, inverse_document_freq, out + i);
+    }
+
+    SCORING_TARGET("avx512f")
+    void ScaleQuantizedAvx512(const uint8_t *quantized, size_t count, double step, double inverse_document_freq, double *out)
+    {
+        const __m512d step_pd = _mm512_set1_pd(step);
+        const __m512d idf = _mm512_set1_pd(inverse_document_freq);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(quantized + i));
+            const __m512d values = _mm512_maskz_cvtepi32_pd(0xFF, _mm256_cvtepu8_epi32(bytes));
+            _mm512_storeu_pd(out + i, _mm512_mul_pd(_mm512_mul_pd(values, step_pd), idf));
+        }
+        ScaleQuantizedScalar(quantized + i, count - i, step, inverse_document_freq, out + i);
+    }
+#endif
+
+#if defined(SCORING_KERNEL_X86) && defined(_MSC_VER)
+    bool CpuSupports(ScoringKernel kernel)
+    {
+        int info[4];
+        __cpuid(info, 1);
+        const bool os_saves_ymm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+        if (!os_saves_ymm)
+            return false;
+
+        __cpuidex(info, 7, 0);
+        if (kernel == ScoringKernel::AVX2)
+            return info[1] & (1 << 5);
+
+        const bool os_saves_zmm = (_xgetbv(0) & 0xE6) == 0xE6;
+        return os_saves_zmm && (info[1] & (1 << 16));
+    }
+#elif defined(SCORING_KERNEL_X86)
+    bool CpuSupports(ScoringKernel kernel)
+    {
+        return kernel == ScoringKernel::AVX2 ? __builtin_cpu_supports("avx2") : __builtin_cpu_supports("avx512f");
+    }
+#endif
+
+    ScoringKernel DetectScoringKernel()
+    {
+        if (IsScoringKernelSupported(ScoringKernel::AVX512))
+            return ScoringKernel::AVX512;
+        if (IsScoringKernelSupported(ScoringKernel::AVX2))
+            return ScoringKernel::AVX2;
+        return ScoringKernel::SCALAR;
+    }
+
+    std::atomic<ScoringKernel> &ActiveKernel()
+    {
+        static std::atomic<ScoringKernel> kernel{DetectScoringKernel()};
+        return kernel;
+    }
+}
+
+bool IsScoringKernelSupported(ScoringKernel kernel)
+{
+    if (kernel == ScoringKernel::SCALAR)
+        return true;
+#ifdef SCORING_KERNEL_X86
+    return CpuSupports(kernel);
+#else
+    return false;
+#endif
+}
+
+ScoringKernel GetScoringKernel()
+{
+    return ActiveKernel().load(std::memory_order_relaxed);
+}
+
+bool SetScoringKernel(ScoringKernel kernel)
+{
+    if (!IsScoringKernelSupported(kernel))
+        return false;
+
+    ActiveKernel().store(kernel, std::memory_order_relaxed);
+    return true;
+}
+
+void ScaleTermFreqs(const double *term_freqs, size_t count, double inverse_document_freq, double *out)
+{
+    switch (GetScoringKernel())
+    {
+#ifdef SCORING_KERNEL_X86
+    case ScoringKernel::AVX512:
+        ScaleAvx512(term_freqs, count, inverse_document_freq, out);
+        break;
+    case ScoringKernel::AVX2:
+        ScaleAvx2(term_freqs, count, inverse_document_freq, out);
+        break;
+#endif
+    default:
+        ScaleScalar(term_freqs, count, inverse_document_freq, out);
+        break;
+    }
+}
+
+template <typename Quantized>
+static void DispatchScaleQuantized(const Quantized *quantized, size_t count, double step, double inverse_document_freq, double *out)
+{
+    switch (GetScoringKernel())
+    {
+#ifdef SCORING_KERNEL_X86
+    case ScoringKernel::AVX512:
+        ScaleQuantizedAvx512(quantized, count, step, inverse_document_freq, out);
+        break;
+    case ScoringKernel::AVX2:
+        ScaleQuantizedAvx2(quantized, count, step, inverse_document_freq, out);
+        break;
+#endif
+    default:
+        ScaleQuantizedScalar(quantized, count, step, inverse_document_freq, out);
+        break;
+    }
+}
+
+void ScaleQuantizedTermFreqs(const uint16_t *quantized, size_t count, double step, double inverse_document_freq, double *out)
+{
+    DispatchScaleQuantized(quantized, count, step, inverse_document_freq, out);
+}
+
+void ScaleQuantizedTermFreqs(const uint8_t *quantized, size_t count, double step, double inverse_document_freq, double *out)
+{
+    DispatchScaleQuantized(quantized, count, step, inverse_document_freq, out);
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/// @brief Реализация ядра подсчёта релевантности, выбирается по возможностям процессора
+enum class ScoringKernel
+{
+    SCALAR,
+    AVX2,
+    AVX512,
+};
+
+/// @brief Ядро, используемое сейчас. При первом вызове выбирается лучшее из поддерживаемых процессором
+ScoringKernel GetScoringKernel();
+
+/// @brief Принудительно выбрать ядро
+/// @return false, если процессор не поддерживает ядро, выбор при этом не меняется
+bool SetScoringKernel(ScoringKernel kernel);
+
+bool IsScoringKernelSupported(ScoringKernel kernel);
+
+/// @brief out[i] = term_freqs[i] * inverse_document_freq для блока частот.
+/// Ядро только поэлементно умножает, без FMA и без переупорядочивания сложений,
+/// поэтому все реализации дают побитово одинаковый результат.
+void ScaleTermFreqs(const double *term_freqs, size_t count, double inverse_document_freq, double *out);
+
+/// @brief out[i] = (quantized[i] * step) * inverse_document_freq для квантованных частот
+void ScaleQuantizedTermFreqs(const uint16_t *quantized, size_t count, double step, double inverse_document_freq, double *out);
+void ScaleQuantizedTermFreqs(const uint8_t *quantized, size_t count, double step, double inverse_document_freq, double *out);
@@ -0,0 +1,55 @@
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include "search_page.h"
+
+namespace
+{
+    template <typename Number>
+    std::string_view ReadField(std::string_view text, Number &value, int base, bool last)
+    {
+        const char *end = text.data() + text.size();
+        const auto [ptr, error] = std::from_chars(text.data(), end, value, base);
+        if (error != std::errc{} || (last ? ptr != end : ptr == end || *ptr != ':'))
+            throw std::invalid_argument("incorrect cursor");
+
+        return last ? std::string_view{} : text.substr(ptr - text.data() + 1);
+    }
+
+    template <typename Number>
+    void WriteField(std::string &text, Number value, int base)
+    {
+        char buffer[24]; // 64-битное число занимает не больше 20 десятичных знаков со знаком минус
+        const auto [ptr, error] = std::to_chars(buffer, buffer + sizeof(buffer), value, base);
+        if (error != std::errc{})
+            throw std::logic_error("cursor field does not fit");
+
+        if (!text.empty())
+        {
+            text.push_back(':');
+        }
+        text.append(buffer, ptr);
+    }
+}
+
+std::string EncodeCursor(const SearchCursor &cursor)
+{
+    std::string text;
+    WriteField(text, std::bit_cast<uint64_t>(cursor.relevance), 16);
+    WriteField(text, cursor.rating, 10);
+    WriteField(text, cursor.id, 10);
+    return text;
+}
+
+SearchCursor DecodeCursor(std::string_view text)
+{
+    uint64_t relevance_bits = 0;
+    SearchCursor cursor;
+    text = ReadField(text, relevance_bits, 16, false);
+    text = ReadField(text, cursor.rating, 10, false);
+    ReadField(text, cursor.id, 10, true);
+    cursor.relevance = std::bit_cast<double>(relevance_bits);
+    return cursor;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "document.h"
+
+const size_t DEFAULT_PAGE_SIZE = 20;
+
+/// @brief Место в выдаче сразу после документа: следующая страница начинается с документа, который ранжируется ниже
+struct SearchCursor
+{
+    double relevance = 0;
+    int rating = 0;
+    int id = 0;
+};
+
+/// @brief Окно выдачи: limit документов, пропустив offset документов после after (или от начала выдачи)
+struct PageRequest
+{
+    size_t offset = 0;
+    size_t limit = DEFAULT_PAGE_SIZE;
+    std::optional<SearchCursor> after;
+};
+
+struct SearchPage
+{
+    std::vector<Document> documents;
+    std::optional<SearchCursor> next; // курсор следующей страницы, nullopt на последней странице
+};
+
+/// @brief Курсор в виде строки для передачи клиенту. Релевантность сохраняется побитово
+std::string EncodeCursor(const SearchCursor &cursor);
+
+/// @throw std::invalid_argument если строка не получена из EncodeCursor
+SearchCursor DecodeCursor(std::string_view text);
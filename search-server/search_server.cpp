@@ -2,41 +2,212 @@
 #include <algorithm>
 #include <numeric>
 #include <cmath>
+#include <bit>
+#include <charconv>
+#include <iterator>
 #include "search_server.h"
 
+namespace
+{
+    // узел красно-чёрного дерева: три указателя и цвет
+    const size_t TREE_NODE_OVERHEAD = 4 * sizeof(void *);
+
+    /// @brief Слова terms, которые есть в документе, по возрастанию номера.
+    /// Короткий запрос ищется в документе двоичным поиском, иначе оба отсортированных списка сливаются
+    template <typename Visitor>
+    void ForEachCommonTerm(std::span<const TermDictionary::TermId> terms, std::span<const ForwardEntry> entries, Visitor visitor)
+    {
+        if (terms.size() * std::bit_width(entries.size()) < entries.size())
+        {
+            auto entry = entries.begin();
+            for (const TermDictionary::TermId term : terms)
+            {
+                entry = std::partition_point(entry, entries.end(), [term](const ForwardEntry &e)
+                                             { return e.term < term; });
+                if (entry != entries.end() && entry->term == term)
+                {
+                    visitor(term);
+                }
+            }
+            return;
+        }
+
+        auto entry = entries.begin();
+        for (auto term = terms.begin(); term != terms.end() && entry != entries.end();)
+        {
+            if (*term < entry->term)
+            {
+                ++term;
+            }
+            else if (entry->term < *term)
+            {
+                ++entry;
+            }
+            else
+            {
+                visitor(*term);
+                ++term;
+                ++entry;
+            }
+        }
+    }
+
+    bool ContainsAnyTerm(std::span<const TermDictionary::TermId> terms, std::span<const ForwardEntry> entries)
+    {
+        bool found = false;
+        // обход не прерывается, но минус-слов в запросе обычно немного
+        ForEachCommonTerm(terms, entries, [&found](TermDictionary::TermId)
+                          { found = true; });
+        return found;
+    }
+
+    size_t GetStringHeapUsage(const std::string &str)
+    {
+        // короткие строки хранятся внутри объекта
+        return str.capacity() > std::string{}.capacity() ? str.capacity() + 1 : 0;
+    }
+
+    size_t GetStringSetUsage(const std::set<std::string, std::less<>> &strings)
+    {
+        size_t bytes = strings.size() * (TREE_NODE_OVERHEAD + sizeof(std::string));
+        for (const std::string &str : strings)
+        {
+            bytes += GetStringHeapUsage(str);
+        }
+        return bytes;
+    }
+
+    using Ordinal = DocumentAttributes::Ordinal;
+
+    /// @brief Оставить в ordinals номера, которые есть в other. ordinals короче: каждый номер ищется в other
+    /// галопом от предыдущей найденной позиции
+    void IntersectGalloping(std::vector<Ordinal> &ordinals, std::span<const Ordinal> other)
+    {
+        size_t kept = 0;
+        size_t position = 0;
+        for (const Ordinal ordinal : ordinals)
+        {
+            size_t high = position;
+            for (size_t step = 1; high < other.size() && other[high] < ordinal; step *= 2)
+            {
+                position = high + 1;
+                high += step;
+            }
+            high = std::min(high, other.size());
+            position = std::lower_bound(other.begin() + position, other.begin() + high, ordinal) - other.begin();
+            if (position == other.size())
+            {
+                break;
+            }
+            if (other[position] == ordinal)
+            {
+                ordinals[kept++] = ordinal;
+            }
+        }
+        ordinals.resize(kept);
+    }
+
+    /// @brief Оставить номера, которые есть (keep) или которых нет в списке документов слова
+    void FilterByPostings(std::vector<Ordinal> &ordinals, const PostingList &postings, bool keep)
+    {
+        PostingList::Cursor cursor(postings);
+        size_t kept = 0;
+        for (const Ordinal ordinal : ordinals)
+        {
+            const bool found = cursor.SkipTo(ordinal) && cursor.GetOrdinal() == ordinal;
+            if (found == keep)
+            {
+                ordinals[kept++] = ordinal;
+            }
+        }
+        ordinals.resize(kept);
+    }
+
+    void UniteSorted(std::vector<Ordinal> &ordinals, std::span<const Ordinal> other)
+    {
+        std::vector<Ordinal> united;
+        united.reserve(ordinals.size() + other.size());
+        std::set_union(ordinals.begin(), ordinals.end(), other.begin(), other.end(), std::back_inserter(united));
+        ordinals = std::move(united);
+    }
+}
+
 ///
 /// public
 ///
 
 void SearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int> &ratings)
 {
-    //      id.    id 
+    LATENCY_SCOPE(LatencyStage::ADD_DOCUMENT);
+    // Попытка добавить документ с отрицательным id. Или уже такой id есть
     if (document_id < 0)
         throw std::invalid_argument("document_id must be positive");
 
-    if (documents_.count(document_id))
+    if (attributes_.Contains(document_id))
         throw std::invalid_argument("document_id already exists");
 
-    const std::vector<std::string> words = SplitIntoWordsNoStop(document);
+    std::vector<uint32_t> positions;
+    const std::vector<std::string> words = SplitIntoWordsNoStop(document, options_.store_positions ? &positions : nullptr);
+    const Ordinal ordinal = attributes_.Add(document_id, ComputeAverageRating(ratings), status);
 
-    const double inv_word_count = 1.0 / words.size();
-    std::map<std::string_view, double> wordFrequencies;
+    std::vector<TermId> terms;
+    terms.reserve(words.size());
     for (const std::string &word : words)
     {
-        const auto &w = unique_words_.insert(word);
-        word_to_document_freqs_[*w.first][document_id] += inv_word_count;
-        wordFrequencies[*w.first] = word_to_document_freqs_[*w.first][document_id];
+        const size_t dictionary_size = term_dictionary_.size();
+        terms.push_back(term_dictionary_.Add(word));
+        if (options_.max_fuzzy_distance > 0 && term_dictionary_.size() > dictionary_size)
+        {
+            fuzzy_index_.Add(terms.back(), word);
+        }
+    }
+    if (term_postings_.size() < term_dictionary_.size())
+    {
+        term_postings_.resize(term_dictionary_.size());
+    }
+    std::sort(terms.begin(), terms.end());
+
+    // частота набирается сложением, как и раньше, чтобы релевантность не менялась в последних битах
+    const double inv_word_count = 1.0 / words.size();
+    std::vector<ForwardEntry> entries;
+    for (const TermId term : terms)
+    {
+        if (entries.empty() || entries.back().term != term)
+        {
+            entries.push_back({term, 0.0});
+        }
+        entries.back().term_freq += inv_word_count;
+    }
+    for (const ForwardEntry &entry : entries)
+    {
+        term_postings_[entry.term][status].Add(ordinal, entry.term_freq, options_.term_freq_mode);
+    }
+    if (options_.forward_index_mode == ForwardIndexMode::IN_MEMORY)
+    {
+        forward_index_.Add(ordinal, entries);
     }
-    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
-    id_to_wordfreqs_.emplace(document_id, wordFrequencies);
-    index2id_.insert(document_id);
+    else
+    {
+        term_ids_.Add(ordinal, entries);
+    }
+    if (options_.store_positions)
+    {
+        std::vector<TermPosition> term_positions(words.size());
+        for (size_t i = 0; i < words.size(); ++i)
+        {
+            term_positions[i] = {term_dictionary_.Find(words[i]), positions[i]};
+        }
+        std::sort(term_positions.begin(), term_positions.end(), [](const TermPosition &lhs, const TermPosition &rhs)
+                  { return lhs.term < rhs.term || (lhs.term == rhs.term && lhs.position < rhs.position); });
+        position_index_.Add(ordinal, term_positions);
+    }
+    index2id_.Add(static_cast<DocumentSet::Value>(document_id));
+    ++generation_;
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status_query) const
 {
-    return FindTopDocuments(
-        raw_query, [status_query](int document_id, DocumentStatus status, int rating)
-        { return status == status_query; });
+    return FindTopDocumentsImpl(std::execution::seq, raw_query, status_query);
 }
 std::vector<Document> SearchServer::FindTopDocuments(const std::execution::sequenced_policy, const std::string_view raw_query, DocumentStatus status_query) const
 {
@@ -44,16 +215,12 @@ std::vector<Document> SearchServer::FindTopDocuments(const std::execution::seque
 }
 std::vector<Document> SearchServer::FindTopDocuments(const std::execution::parallel_policy, const std::string_view raw_query, DocumentStatus status_query) const
 {
-    return FindTopDocuments(
-        std::execution::par, raw_query, [status_query](int document_id, DocumentStatus status, int rating)
-        { return status == status_query; });
+    return FindTopDocumentsImpl(std::execution::par, raw_query, status_query);
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query) const
 {
-    return FindTopDocuments(
-        raw_query, [](int document_id, DocumentStatus status, int rating)
-        { return status == DocumentStatus::ACTUAL; });
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
 }
 std::vector<Document> SearchServer::FindTopDocuments(const std::execution::sequenced_policy, const std::string_view raw_query) const
 {
@@ -63,83 +230,210 @@ std::vector<Document> SearchServer::FindTopDocuments(const std::execution::paral
 {
     return FindTopDocuments(std::execution::par, raw_query, DocumentStatus::ACTUAL);
 }
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutorPolicy &policy, const std::string_view raw_query) const
+{
+    return FindTopDocumentsImpl(policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+std::future<std::vector<Document>> SearchServer::SubmitFindTopDocuments(std::string raw_query, DocumentStatus status) const
+{
+    return GetExecutor().Submit([this, raw_query = std::move(raw_query), status]()
+                                { return FindTopDocuments(std::execution::seq, raw_query, status); });
+}
+
+std::future<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::SubmitMatchDocument(std::string raw_query, int document_id) const
+{
+    return GetExecutor().Submit([this, raw_query = std::move(raw_query), document_id]()
+                                { return MatchDocument(std::execution::seq, raw_query, document_id); });
+}
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::string_view raw_query, int document_id) const
 {
+    LATENCY_SCOPE(LatencyStage::MATCH_DOCUMENT);
+    RequireForwardIndex();
 
-    if (0 == id_to_wordfreqs_.count(document_id))
+    if (!attributes_.Contains(document_id))
     {
         throw std::out_of_range{"Document id in not exsist: " + std::to_string(document_id)};
     }
 
-    Query query = ParseQuery(raw_query);
+    // номера слов сортируются дешевле строк, поэтому запрос разбирается без сортировки
+    return MatchQueryTerms(MakeQueryTerms(ParseQuery(raw_query, false)), document_id);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::sequenced_policy, const std::string_view raw_query, int document_id) const
+{
+    return MatchDocument(raw_query, document_id);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::parallel_policy, const std::string_view raw_query, int document_id) const
+{
+    // слияние двух коротких отсортированных списков быстрее, чем раздача слов по потокам
+    if (document_id < 0)
+        throw std::out_of_range("document_id must be positive");
+
+    return MatchDocument(raw_query, document_id);
+}
 
-    const std::map<std::string_view, double> &words_freqs{
-        id_to_wordfreqs_.at(document_id)};
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(const std::string_view raw_query, std::span<const int> document_ids) const
+{
+    return MatchDocuments(std::execution::seq, raw_query, document_ids);
+}
 
-    for (const auto &[word, freq] : words_freqs)
+SearchServer::QueryTerms SearchServer::MakeQueryTerms(const Query &query) const
+{
+    const auto to_terms = [this](const std::vector<std::string_view> &words)
     {
-        if (find(query.minus_words.begin(), query.minus_words.end(), word) != query.minus_words.end())
+        std::vector<TermId> terms;
+        terms.reserve(words.size());
+        for (const std::string_view word : words)
         {
-            return {std::vector<std::string_view>{}, documents_.at(document_id).status};
+            const TermId term = term_dictionary_.Find(word);
+            if (term != TermDictionary::NO_TERM)
+            {
+                terms.push_back(term);
+            }
         }
+        std::sort(terms.begin(), terms.end());
+        terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+        return terms;
+    };
+    return {to_terms(query.plus_words), to_terms(query.minus_words), query.boolean_nodes};
+}
+
+template <typename Contains>
+bool SearchServer::MatchesBooleanNode(std::span<const BooleanNode> nodes, uint32_t index, Contains contains)
+{
+    const BooleanNode &node = nodes[index];
+    if (node.is_leaf)
+    {
+        return std::any_of(node.words.begin(), node.words.end(), contains);
     }
 
-    std::vector<std::string_view> matched_words;
-    for (const auto &[word, freq] : words_freqs)
+    bool has_must = false;
+    bool any_should = false;
+    for (const BooleanClause &clause : node.clauses)
     {
-        if (find(query.plus_words.begin(), query.plus_words.end(), word) != query.plus_words.end())
+        switch (clause.occur)
         {
-            matched_words.push_back(word);
+        case Occur::MUST:
+            has_must = true;
+            if (!MatchesBooleanNode(nodes, clause.node, contains))
+            {
+                return false;
+            }
+            break;
+        case Occur::MUST_NOT:
+            if (MatchesBooleanNode(nodes, clause.node, contains))
+            {
+                return false;
+            }
+            break;
+        case Occur::SHOULD:
+            any_should = any_should || MatchesBooleanNode(nodes, clause.node, contains);
+            break;
         }
     }
-
-    return {matched_words, documents_.at(document_id).status};
+    return has_must || any_should;
 }
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::sequenced_policy, const std::string_view raw_query, int document_id) const
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchQueryTerms(const QueryTerms &query, int document_id) const
 {
-    return MatchDocument(raw_query, document_id);
+    const Ordinal ordinal = attributes_.FindOrdinal(document_id);
+    if (ordinal == DocumentAttributes::NO_ORDINAL)
+    {
+        throw std::out_of_range{"Document id in not exsist: " + std::to_string(document_id)};
+    }
+    const DocumentStatus status = attributes_.GetStatus(ordinal);
+    const std::span<const ForwardEntry> entries = forward_index_.Get(ordinal);
+
+    if (ContainsAnyTerm(query.minus_terms, entries))
+    {
+        return {std::vector<std::string_view>{}, status};
+    }
+    if (!query.boolean_nodes.empty() && !MatchesBooleanNode(query.boolean_nodes, 0, [this, entries](std::string_view word)
+                                                            {
+                                                                const TermId term = term_dictionary_.Find(word);
+                                                                return term != TermDictionary::NO_TERM && ContainsAnyTerm(std::span{&term, 1}, entries); }))
+    {
+        return {std::vector<std::string_view>{}, status};
+    }
+
+    std::vector<std::string_view> matched_words;
+    ForEachCommonTerm(query.plus_terms, entries, [this, &matched_words](TermId term)
+                      { matched_words.push_back(term_dictionary_.GetWord(term)); });
+    // номера слов выдаются в порядке появления, а слова возвращаются по алфавиту
+    std::sort(matched_words.begin(), matched_words.end());
+    return {matched_words, status};
 }
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::parallel_policy, const std::string_view raw_query, int document_id) const
+DocumentTerms SearchServer::GetWordFrequencies(int document_id) const
 {
-    if (document_id < 0)
-        throw std::out_of_range("document_id must be positive");
+    // пустой результат выдал бы все документы за дубликаты друг друга
+    RequireForwardIndex();
+    const Ordinal ordinal = attributes_.FindOrdinal(document_id);
+    if (ordinal == DocumentAttributes::NO_ORDINAL)
+    {
+        return {};
+    }
+    return {forward_index_.Get(ordinal), term_dictionary_};
+}
 
-    const std::map<std::string_view, double> &words_freqs{id_to_wordfreqs_.at(document_id)};
-    if (words_freqs.empty())
-        return {std::vector<std::string_view>{}, documents_.at(document_id).status};
+IndexStats SearchServer::GetIndexStats(size_t largest_count) const
+{
+    IndexStats stats;
+    stats.document_count = attributes_.GetAliveCount();
 
-    const Query query = ParseQuery(raw_query, false);
+    stats.memory.inverted_index = term_postings_.capacity() * sizeof(StatusPartitioned<PostingList>);
 
-    auto checker = [&](const std::string_view word)
+    std::vector<std::pair<std::string_view, size_t>> posting_lengths;
+    posting_lengths.reserve(term_postings_.size());
+    for (TermId term = 0; term < term_postings_.size(); ++term)
     {
-        return words_freqs.find(word) != words_freqs.end();
-    };
-
-    if (any_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(), checker))
-        return {std::vector<std::string_view>{}, documents_.at(document_id).status};
-
-    std::vector<std::string_view> matched_words(query.plus_words.size());
-    auto words_end = copy_if(std::execution::par, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), checker);
+        const StatusPartitioned<PostingList> &postings = term_postings_[term];
+        for (const PostingList &posting_list : postings)
+        {
+            stats.memory.inverted_index += posting_list.GetMemoryUsage();
+        }
 
-    std::sort(std::execution::par, matched_words.begin(), words_end);
-    words_end = unique(std::execution::par, matched_words.begin(), words_end);
-    matched_words.resize(std::distance(matched_words.begin(), words_end));
+        const size_t length = postings.size();
+        if (length == 0)
+        {
+            // слово осталось в словаре после удаления всех его документов
+            continue;
+        }
+        ++stats.term_count;
+        stats.posting_count += length;
+        size_t bucket = 0;
+        while (bucket + 1 < POSTING_HISTOGRAM_SIZE && (length >> (bucket + 1)) != 0)
+        {
+            ++bucket;
+        }
+        ++stats.posting_length_histogram[bucket];
+        posting_lengths.emplace_back(term_dictionary_.GetWord(term), length);
+    }
 
-    return {matched_words, documents_.at(document_id).status};
-}
+    const auto longer = [](const auto &lhs, const auto &rhs)
+    {
+        return lhs.second != rhs.second ? lhs.second > rhs.second : lhs.first < rhs.first;
+    };
+    const size_t largest = std::min(largest_count, posting_lengths.size());
+    std::partial_sort(posting_lengths.begin(), posting_lengths.begin() + largest, posting_lengths.end(), longer);
+    posting_lengths.resize(largest);
+    stats.largest_postings = std::move(posting_lengths);
 
-const std::map<std::string_view, double> &SearchServer::GetWordFrequencies(int document_id) const
-{
-    if (!id_to_wordfreqs_.count(document_id))
+    if (stats.document_count > 0)
     {
-        static const std::map<std::string_view, double> ret;
-        return ret;
+        stats.average_document_terms = static_cast<double>(stats.posting_count) / stats.document_count;
     }
 
-    return id_to_wordfreqs_.at(document_id);
+    stats.memory.forward_index = forward_index_.GetMemoryUsage() + term_ids_.GetMemoryUsage();
+    stats.memory.positions = position_index_.GetMemoryUsage();
+    stats.memory.fuzzy_terms = fuzzy_index_.GetMemoryUsage();
+    stats.memory.documents = attributes_.GetMemoryUsage() + index2id_.GetMemoryUsage() + tombstones_.GetMemoryUsage();
+    stats.memory.term_dictionary = term_dictionary_.GetMemoryUsage();
+    stats.memory.stop_words = GetStringSetUsage(stop_words_);
+    return stats;
 }
 
 void SearchServer::RemoveDocument(int document_id)
@@ -147,6 +441,15 @@ void SearchServer::RemoveDocument(int document_id)
     RemoveDocument(std::execution::seq, document_id);
 }
 
+void SearchServer::PurgeRemovedDocuments()
+{
+    if (!tombstones_.empty())
+    {
+        PurgeTombstones(GetExecutor().Policy());
+        ++generation_;
+    }
+}
+
 ///
 /// private
 ///
@@ -158,9 +461,10 @@ bool SearchServer::IsValidWord(const std::string_view word)
                         { return c >= '\0' && c < ' '; });
 }
 
-std::vector<std::string> SearchServer::SplitIntoWordsNoStop(const std::string_view text) const
+std::vector<std::string> SearchServer::SplitIntoWordsNoStop(const std::string_view text, std::vector<uint32_t> *positions) const
 {
     std::vector<std::string> words;
+    uint32_t position = 0;
     for (const std::string &word : SplitIntoWords(text))
     {
         if (!IsValidWord(word))
@@ -169,7 +473,12 @@ std::vector<std::string> SearchServer::SplitIntoWordsNoStop(const std::string_vi
         if (!IsStopWord(word))
         {
             words.push_back(word);
+            if (positions != nullptr)
+            {
+                positions->push_back(position);
+            }
         }
+        ++position;
     }
     return words;
 }
@@ -230,24 +539,65 @@ SearchServer::QueryWordView SearchServer::ParseQueryWord(std::string_view text)
         if (text[0] == '-')
             throw std::invalid_argument("incorrect query minus-words");
     }
-    return {text, is_minus, IsStopWord(text)};
+
+    bool is_prefix = false;
+    if (text.back() == '*')
+    {
+        is_prefix = true;
+        text.remove_suffix(1);
+
+        if (text.empty())
+            throw std::invalid_argument("prefix is empty");
+    }
+    return {text, is_minus, !is_prefix && IsStopWord(text), is_prefix};
+}
+
+SearchServer::Query SearchServer::ParseSearchQuery(const std::string_view text) const
+{
+    LATENCY_SCOPE(LatencyStage::QUERY_PARSE);
+    return ParseQuery(text, true);
 }
 
 SearchServer::Query SearchServer::ParseQuery(const std::string_view text, bool sort) const
 {
     Query query;
-    for (const std::string_view &word : SplitIntoWordsView(text))
+    const std::vector<std::string_view> tokens = SplitIntoWordsView(text);
+    if (IsBooleanQuery(tokens))
     {
-        const QueryWordView query_word = ParseQueryWord(word);
-        if (!query_word.is_stop)
+        ParseBooleanQuery(tokens, query);
+    }
+    else
+    {
+        for (size_t i = 0; i < tokens.size(); ++i)
         {
-            if (query_word.is_minus)
+            if (!tokens[i].empty() && tokens[i][0] == '"')
             {
-                query.minus_words.push_back(query_word.data);
+                i = ParsePhrase(tokens, i, query);
+                continue;
             }
-            else
+
+            const QueryWordView query_word = ParseQueryWord(tokens[i]);
+            if (query_word.is_prefix)
             {
-                query.plus_words.push_back(query_word.data);
+                if (query_word.is_minus)
+                {
+                    ExpandPrefix(query_word.data, term_dictionary_.size(), query.minus_words);
+                }
+                else
+                {
+                    ExpandPrefix(query_word.data, options_.max_prefix_expansions, query.plus_words);
+                }
+            }
+            else if (!query_word.is_stop)
+            {
+                if (query_word.is_minus)
+                {
+                    query.minus_words.push_back(query_word.data);
+                }
+                else
+                {
+                    query.plus_words.push_back(query_word.data);
+                }
             }
         }
     }
@@ -266,8 +616,782 @@ SearchServer::Query SearchServer::ParseQuery(const std::string_view text, bool s
     return query;
 }
 
-// Existence required
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word) const
+bool SearchServer::IsBooleanQuery(std::span<const std::string_view> tokens) const
+{
+    // операторами считаются только целые токены, если они не стоп-слова
+    const auto is_operator = [this](std::string_view token)
+    {
+        return (token == "AND" || token == "OR" || token == "NOT") && !IsStopWord(token);
+    };
+
+    // скобки делают запрос логическим, только если они парные и охватывают несколько токенов:
+    // smile:) и (c) остаются обычными словами
+    std::vector<size_t> opened; // номера токенов открытых скобок
+    bool has_group = false;
+    for (size_t i = 0; i < tokens.size(); ++i)
+    {
+        std::string_view token = tokens[i];
+        if (is_operator(token) || token.starts_with('+'))
+        {
+            return true;
+        }
+        while (!token.empty() && (token[0] == '(' || (token.size() > 1 && token[0] == '-' && token[1] == '(')))
+        {
+            if (token[0] == '(')
+            {
+                opened.push_back(i);
+            }
+            token.remove_prefix(1);
+        }
+        while (!token.empty() && token.back() == ')')
+        {
+            if (opened.empty())
+            {
+                return false;
+            }
+            has_group = has_group || opened.back() != i;
+            opened.pop_back();
+            token.remove_suffix(1);
+        }
+    }
+    return has_group && opened.empty();
+}
+
+void SearchServer::ParseBooleanQuery(std::span<const std::string_view> tokens, Query &query) const
+{
+    // скобки и знаки перед скобкой отделяются от слов в собственные токены
+    std::vector<std::string_view> split;
+    for (std::string_view token : tokens)
+    {
+        if (token.empty())
+        {
+            split.push_back(token);
+            continue;
+        }
+        while (!token.empty() && (token[0] == '(' || (token.size() > 1 && (token[0] == '+' || token[0] == '-') && token[1] == '(')))
+        {
+            split.push_back(token.substr(0, 1));
+            token.remove_prefix(1);
+        }
+        size_t closing = 0;
+        while (!token.empty() && token.back() == ')')
+        {
+            ++closing;
+            token.remove_suffix(1);
+        }
+        if (!token.empty())
+        {
+            split.push_back(token);
+        }
+        split.insert(split.end(), closing, ")");
+    }
+
+    size_t i = 0;
+    ParseBooleanOr(split, i, query);
+    if (i != split.size())
+        throw std::invalid_argument("unbalanced parentheses");
+
+    // плюс-слова - все слова не под отрицанием, минус-слова - отрицания верхнего уровня
+    const auto collect = [&query](const auto &self, uint32_t index, bool negated) -> void
+    {
+        const BooleanNode &node = query.boolean_nodes[index];
+        if (node.is_leaf)
+        {
+            if (!negated)
+            {
+                query.plus_words.insert(query.plus_words.end(), node.words.begin(), node.words.end());
+            }
+            return;
+        }
+        for (const BooleanClause &clause : node.clauses)
+        {
+            self(self, clause.node, negated || clause.occur == Occur::MUST_NOT);
+        }
+    };
+    collect(collect, 0, false);
+    for (const BooleanClause &clause : query.boolean_nodes[0].clauses)
+    {
+        const BooleanNode &node = query.boolean_nodes[clause.node];
+        if (clause.occur == Occur::MUST_NOT && node.is_leaf)
+        {
+            query.minus_words.insert(query.minus_words.end(), node.words.begin(), node.words.end());
+        }
+    }
+}
+
+uint32_t SearchServer::ParseBooleanOr(std::span<const std::string_view> tokens, size_t &i, Query &query) const
+{
+    const uint32_t index = static_cast<uint32_t>(query.boolean_nodes.size());
+    query.boolean_nodes.push_back({false, {}, {}});
+    while (i < tokens.size() && tokens[i] != ")")
+    {
+        if (tokens[i] == "OR")
+        {
+            ++i;
+            if (query.boolean_nodes[index].clauses.empty() || i == tokens.size() || tokens[i] == ")" || tokens[i] == "OR" || tokens[i] == "AND")
+                throw std::invalid_argument("OR without operand");
+
+            continue;
+        }
+        const BooleanClause clause = ParseBooleanAnd(tokens, i, query);
+        if (clause.node != NO_BOOLEAN_NODE)
+        {
+            query.boolean_nodes[index].clauses.push_back(clause);
+        }
+    }
+    return index;
+}
+
+SearchServer::BooleanClause SearchServer::ParseBooleanAnd(std::span<const std::string_view> tokens, size_t &i, Query &query) const
+{
+    const BooleanClause first = ParseBooleanUnary(tokens, i, query);
+    if (i == tokens.size() || tokens[i] != "AND")
+    {
+        return first;
+    }
+
+    const uint32_t index = static_cast<uint32_t>(query.boolean_nodes.size());
+    query.boolean_nodes.push_back({false, {}, {}});
+    const auto add = [&query, index](const BooleanClause &clause)
+    {
+        // операнды AND обязательны, если не отрицаются
+        if (clause.node != NO_BOOLEAN_NODE)
+        {
+            query.boolean_nodes[index].clauses.push_back({clause.occur == Occur::SHOULD ? Occur::MUST : clause.occur, clause.node});
+        }
+    };
+    add(first);
+    while (i < tokens.size() && tokens[i] == "AND")
+    {
+        ++i;
+        add(ParseBooleanUnary(tokens, i, query));
+    }
+    return {Occur::SHOULD, index};
+}
+
+SearchServer::BooleanClause SearchServer::ParseBooleanUnary(std::span<const std::string_view> tokens, size_t &i, Query &query) const
+{
+    if (i == tokens.size() || tokens[i] == ")" || tokens[i] == "AND" || tokens[i] == "OR")
+        throw std::invalid_argument("operator without operand");
+
+    const std::string_view token = tokens[i++];
+    if (token == "NOT" || token == "-" || token == "+")
+    {
+        const BooleanClause operand = ParseBooleanUnary(tokens, i, query);
+        if (operand.occur == Occur::MUST_NOT)
+            throw std::invalid_argument("double negation");
+
+        return {token == "+" ? Occur::MUST : Occur::MUST_NOT, operand.node};
+    }
+    if (token == "(")
+    {
+        const uint32_t group = ParseBooleanOr(tokens, i, query);
+        if (i == tokens.size())
+            throw std::invalid_argument("unbalanced parentheses");
+
+        ++i;
+        return {Occur::SHOULD, group};
+    }
+    if (token.starts_with('"'))
+        throw std::invalid_argument("phrase in boolean query");
+
+    std::string_view word = token;
+    const bool is_required = word.starts_with('+');
+    if (is_required)
+    {
+        word.remove_prefix(1);
+        if (word.empty() || word[0] == '+' || word[0] == '-')
+            throw std::invalid_argument("incorrect required word");
+    }
+    const QueryWordView query_word = ParseQueryWord(word);
+    if (query_word.is_stop)
+    {
+        return {Occur::SHOULD, NO_BOOLEAN_NODE};
+    }
+
+    BooleanNode leaf;
+    if (query_word.is_prefix)
+    {
+        ExpandPrefix(query_word.data, query_word.is_minus ? term_dictionary_.size() : options_.max_prefix_expansions, leaf.words);
+    }
+    else
+    {
+        leaf.words.push_back(query_word.data);
+    }
+    query.boolean_nodes.push_back(std::move(leaf));
+    const uint32_t index = static_cast<uint32_t>(query.boolean_nodes.size() - 1);
+    return {query_word.is_minus ? Occur::MUST_NOT : is_required ? Occur::MUST : Occur::SHOULD, index};
+}
+
+void SearchServer::ExpandPrefix(std::string_view prefix, size_t max_expansions, std::vector<std::string_view> &words) const
+{
+    std::vector<TermId> terms;
+    term_dictionary_.FindPrefix(prefix, terms);
+    // слова, все документы которых удалены, ничего не найдут
+    std::erase_if(terms, [this](TermId term)
+                  { return term_postings_[term].size() == 0; });
+    if (terms.size() > max_expansions)
+    {
+        const auto more_documents = [this](TermId lhs, TermId rhs)
+        {
+            const size_t lhs_size = term_postings_[lhs].size();
+            const size_t rhs_size = term_postings_[rhs].size();
+            return lhs_size > rhs_size || (lhs_size == rhs_size && lhs < rhs);
+        };
+        std::nth_element(terms.begin(), terms.begin() + max_expansions, terms.end(), more_documents);
+        terms.resize(max_expansions);
+    }
+    for (const TermId term : terms)
+    {
+        words.push_back(term_dictionary_.GetWord(term));
+    }
+}
+
+size_t SearchServer::ParsePhrase(std::span<const std::string_view> tokens, size_t first, Query &query) const
+{
+    Phrase phrase;
+    uint32_t offset = 0;
+    for (size_t i = first; i < tokens.size(); ++i)
+    {
+        std::string_view token = tokens[i];
+        if (i == first)
+        {
+            token.remove_prefix(1);
+        }
+        const size_t quote = token.find('"');
+        const bool closed = quote != std::string_view::npos;
+        const std::string_view suffix = closed ? token.substr(quote + 1) : std::string_view{};
+        token = token.substr(0, quote);
+
+        // пустое слово допустимо только рядом с кавычкой: "" или " слово"
+        if (!token.empty() || (i != first && !closed))
+        {
+            const QueryWordView query_word = ParseQueryWord(token);
+            if (query_word.is_minus)
+                throw std::invalid_argument("minus-word in phrase");
+
+            if (query_word.is_prefix)
+                throw std::invalid_argument("prefix in phrase");
+
+            if (!query_word.is_stop)
+            {
+                phrase.words.push_back(query_word.data);
+                phrase.offsets.push_back(offset);
+                query.plus_words.push_back(query_word.data);
+            }
+            ++offset;
+        }
+
+        if (closed)
+        {
+            if (!suffix.empty())
+            {
+                const char *last = suffix.data() + suffix.size();
+                const auto [end, error] = std::from_chars(suffix.data() + 1, last, phrase.slop);
+                if (suffix[0] != '~' || suffix.size() == 1 || error != std::errc{} || end != last)
+                    throw std::invalid_argument("incorrect phrase slop");
+            }
+            // из одного слова фраза ничего не добавляет к плюс-слову
+            if (phrase.words.size() > 1)
+            {
+                query.phrases.push_back(std::move(phrase));
+            }
+            return i;
+        }
+    }
+    throw std::invalid_argument("phrase is not closed");
+}
+
+SearchPage SearchServer::FindTopDocumentsPage(const std::string_view raw_query, const PageRequest &page, DocumentStatus status) const
+{
+    return FindTopDocumentsPage(std::execution::seq, raw_query, page, status);
+}
+
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(std::span<const std::string> raw_queries, DocumentStatus status) const
+{
+    // разбор последовательный, чтобы исключение о некорректном запросе дошло до вызывающего
+    std::vector<Query> queries;
+    queries.reserve(raw_queries.size());
+    for (const std::string &raw_query : raw_queries)
+    {
+        queries.push_back(ParseQuery(raw_query, true));
+    }
+
+    // групп должно хватить на все потоки, но чем группа больше, тем больше общих слов
+    Executor &executor = GetExecutor();
+    const size_t thread_count = executor.GetThreadCount();
+    const size_t chunk_size = std::clamp<size_t>((queries.size() + thread_count * 4 - 1) / (thread_count * 4), 1, MAX_BATCH_CHUNK_SIZE);
+    const size_t chunk_count = (queries.size() + chunk_size - 1) / chunk_size;
+
+    std::vector<std::vector<Document>> results(queries.size());
+    executor.ParallelFor(chunk_count,
+                         [&](size_t chunk)
+                         {
+                             const size_t first = chunk * chunk_size;
+                             const size_t count = std::min(chunk_size, queries.size() - first);
+                             ScoreBatchChunk(std::span<const Query>{queries}.subspan(first, count), status,
+                                             std::span<std::vector<Document>>{results}.subspan(first, count));
+                         });
+    return results;
+}
+
+std::string SearchServer::MakeResultCacheKey(const Query &query, DocumentStatus status)
+{
+    // управляющие символы не встречаются в словах (см. IsValidWord), поэтому служат разделителями
+    std::string key;
+    key += static_cast<char>(status);
+    key += std::to_string(MAX_RESULT_DOCUMENT_COUNT);
+    for (const std::string_view word : query.plus_words)
+    {
+        key += '\x1f';
+        key += word;
+    }
+    key += '\x1e';
+    for (const std::string_view word : query.minus_words)
+    {
+        key += '\x1f';
+        key += word;
+    }
+    for (const BooleanNode &node : query.boolean_nodes)
+    {
+        key += '\x1b';
+        for (const std::string_view word : node.words)
+        {
+            key += '\x1f';
+            key += word;
+        }
+        for (const BooleanClause &clause : node.clauses)
+        {
+            key += '\x1c';
+            key += std::to_string(static_cast<int>(clause.occur));
+            key += ':';
+            key += std::to_string(clause.node);
+        }
+    }
+    for (const Phrase &phrase : query.phrases)
+    {
+        key += '\x1d';
+        key += std::to_string(phrase.slop);
+        for (size_t i = 0; i < phrase.words.size(); ++i)
+        {
+            key += '\x1f';
+            key += std::to_string(phrase.offsets[i]);
+            key += '\x1c';
+            key += phrase.words[i];
+        }
+    }
+    return key;
+}
+
+void SearchServer::ScoreBatchChunk(std::span<const Query> queries, DocumentStatus status, std::span<std::vector<Document>> results) const
+{
+    // слова обходятся в лексикографическом порядке, а плюс-слова каждого запроса отсортированы,
+    // поэтому вклады в релевантность документа складываются в том же порядке, что и при отдельном запросе
+    std::map<std::string_view, std::vector<uint32_t>> plus_word_queries;
+    std::map<std::string_view, std::vector<uint32_t>> minus_word_queries;
+    for (uint32_t i = 0; i < queries.size(); ++i)
+    {
+        // логические запросы считаются отдельно: их документы отбираются пересечением списков
+        if (!queries[i].boolean_nodes.empty())
+        {
+            continue;
+        }
+        for (const std::string_view word : queries[i].plus_words)
+        {
+            plus_word_queries[word].push_back(i);
+        }
+        for (const std::string_view word : queries[i].minus_words)
+        {
+            minus_word_queries[word].push_back(i);
+        }
+    }
+
+    std::vector<RelevanceAccumulator> accumulators(queries.size());
+    std::vector<Ordinal> decoded;
+    std::vector<double> scaled;
+    {
+        LATENCY_SCOPE(LatencyStage::QUERY_SCORE);
+        for (const auto &[word, query_indexes] : plus_word_queries)
+        {
+            const StatusPartitioned<PostingList> *postings = FindPostings(word);
+            if (postings == nullptr || postings->size() == 0)
+            {
+                continue;
+            }
+            const PostingList::View view = (*postings)[status].GetView(decoded);
+            if (view.empty())
+            {
+                continue;
+            }
+            scaled.resize(view.size());
+            ScaleTermFreqs(view.term_freqs, ComputeInverseDocumentFreq(*postings), scaled.data());
+            for (const uint32_t query : query_indexes)
+            {
+                accumulators[query].MergeAddScaled(view.ordinals, scaled);
+            }
+        }
+
+        for (const auto &[word, query_indexes] : minus_word_queries)
+        {
+            const StatusPartitioned<PostingList> *postings = FindPostings(word);
+            if (postings == nullptr)
+            {
+                continue;
+            }
+            const PostingList::View view = (*postings)[status].GetView(decoded);
+            for (const uint32_t query : query_indexes)
+            {
+                accumulators[query].Exclude(view.ordinals);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < queries.size(); ++i)
+    {
+        if (!queries[i].boolean_nodes.empty())
+        {
+            results[i] = FindMatchedDocuments(std::execution::seq, queries[i], status);
+        }
+        else
+        {
+            results[i] = BuildMatchedDocuments(std::span{accumulators}.subspan(i, 1));
+            FilterByPhrases(queries[i], results[i]);
+            FindFuzzyDocuments(std::execution::seq, queries[i], status, results[i]);
+        }
+        SelectTopDocuments(std::execution::seq, results[i]);
+    }
+}
+
+std::vector<Document> SearchServer::BuildMatchedDocuments(std::span<const RelevanceAccumulator> accumulators) const
 {
-    return std::log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+    LATENCY_SCOPE(LatencyStage::QUERY_MATERIALIZE);
+    size_t total = 0;
+    for (const RelevanceAccumulator &accumulator : accumulators)
+    {
+        total += accumulator.size();
+    }
+
+    std::vector<Document> matched_documents;
+    matched_documents.reserve(total);
+    for (const RelevanceAccumulator &accumulator : accumulators)
+    {
+        const auto ordinals = accumulator.GetOrdinals();
+        const auto relevances = accumulator.GetRelevances();
+        for (size_t i = 0; i < ordinals.size(); ++i)
+        {
+            // надгробия остаются в списках документов до очистки
+            if (!tombstones_.empty() && !attributes_.IsAlive(ordinals[i]))
+            {
+                continue;
+            }
+            matched_documents.push_back({attributes_.GetId(ordinals[i]), relevances[i], attributes_.GetRating(ordinals[i])});
+        }
+    }
+    return matched_documents;
+}
+
+bool SearchServer::IsRankedBefore(const Document &lhs, const Document &rhs)
+{
+    if (std::abs(lhs.relevance - rhs.relevance) < calculation_accuracy)
+    {
+        // при равных релевантности и рейтинге порядок определяет id, чтобы seq и par давали одинаковый результат
+        return lhs.rating != rhs.rating ? lhs.rating > rhs.rating : lhs.id < rhs.id;
+    }
+    else
+    {
+        return lhs.relevance > rhs.relevance;
+    }
+}
+
+std::optional<SearchServer::Query> SearchServer::MakeFuzzyQuery(const Query &query) const
+{
+    std::vector<FuzzyWord> fuzzy_words;
+    std::vector<BooleanNode> fuzzy_nodes = query.boolean_nodes;
+    std::vector<FuzzyMatch> matches;
+    for (const std::string_view word : query.plus_words)
+    {
+        const StatusPartitioned<PostingList> *postings = FindPostings(word);
+        if (postings != nullptr && postings->size() > 0)
+        {
+            continue;
+        }
+
+        matches.clear();
+        fuzzy_index_.FindSimilar(word, options_.max_fuzzy_distance, term_dictionary_, matches);
+        // слово, которое уже есть в запросе, не должно получить второй вклад
+        std::erase_if(matches, [this, &query](const FuzzyMatch &match)
+                      { return term_postings_[match.term].size() == 0 ||
+                               std::find(query.plus_words.begin(), query.plus_words.end(), term_dictionary_.GetWord(match.term)) != query.plus_words.end(); });
+        const size_t count = std::min(matches.size(), options_.max_fuzzy_expansions);
+        std::partial_sort(matches.begin(), matches.begin() + count, matches.end(), [this](const FuzzyMatch &lhs, const FuzzyMatch &rhs)
+                          {
+                              if (lhs.distance != rhs.distance)
+                              {
+                                  return lhs.distance < rhs.distance;
+                              }
+                              const size_t lhs_size = term_postings_[lhs.term].size();
+                              const size_t rhs_size = term_postings_[rhs.term].size();
+                              return lhs_size > rhs_size || (lhs_size == rhs_size && lhs.term < rhs.term); });
+        for (size_t i = 0; i < count; ++i)
+        {
+            fuzzy_words.push_back({term_dictionary_.GetWord(matches[i].term), std::pow(options_.fuzzy_distance_penalty, matches[i].distance)});
+        }
+        // в логическом запросе похожие слова могут заменить слово и в его листе
+        for (BooleanNode &node : fuzzy_nodes)
+        {
+            if (node.is_leaf && std::find(node.words.begin(), node.words.end(), word) != node.words.end())
+            {
+                for (size_t i = 0; i < count; ++i)
+                {
+                    node.words.push_back(term_dictionary_.GetWord(matches[i].term));
+                }
+            }
+        }
+    }
+    if (fuzzy_words.empty())
+    {
+        return std::nullopt;
+    }
+
+    // похожие слова разных слов запроса могут совпасть, вклад даёт ближайшее
+    std::stable_sort(fuzzy_words.begin(), fuzzy_words.end(), [](const FuzzyWord &lhs, const FuzzyWord &rhs)
+                     { return lhs.word < rhs.word || (lhs.word == rhs.word && lhs.weight > rhs.weight); });
+    fuzzy_words.erase(std::unique(fuzzy_words.begin(), fuzzy_words.end(), [](const FuzzyWord &lhs, const FuzzyWord &rhs)
+                                  { return lhs.word == rhs.word; }),
+                      fuzzy_words.end());
+
+    Query fuzzy_query = query;
+    fuzzy_query.fuzzy_words = std::move(fuzzy_words);
+    fuzzy_query.boolean_nodes = std::move(fuzzy_nodes);
+    return fuzzy_query;
+}
+
+std::vector<SearchServer::Ordinal> SearchServer::EvaluateBooleanNode(std::span<const BooleanNode> nodes, uint32_t index, DocumentStatus status) const
+{
+    const BooleanNode &node = nodes[index];
+    std::vector<Ordinal> result;
+    std::vector<Ordinal> decoded;
+    if (node.is_leaf)
+    {
+        for (const std::string_view word : node.words)
+        {
+            if (const StatusPartitioned<PostingList> *postings = FindPostings(word))
+            {
+                UniteSorted(result, (*postings)[status].GetView(decoded).ordinals);
+            }
+        }
+        return result;
+    }
+
+    // операнды-слова проверяются по спискам документов курсором, сложные операнды вычисляются в номера
+    std::vector<const PostingList *> must_lists;
+    std::vector<const PostingList *> must_not_lists;
+    std::vector<std::vector<Ordinal>> must_sets;
+    std::vector<std::vector<Ordinal>> must_not_sets;
+    bool has_must = false;
+    for (const BooleanClause &clause : node.clauses)
+    {
+        if (clause.occur == Occur::SHOULD)
+        {
+            continue;
+        }
+        const BooleanNode &child = nodes[clause.node];
+        const bool is_word = child.is_leaf && child.words.size() == 1;
+        const StatusPartitioned<PostingList> *postings = is_word ? FindPostings(child.words[0]) : nullptr;
+        const PostingList *list = postings != nullptr ? &(*postings)[status] : nullptr;
+        if (clause.occur == Occur::MUST)
+        {
+            has_must = true;
+            if (is_word)
+            {
+                if (list == nullptr || list->empty())
+                {
+                    return {};
+                }
+                must_lists.push_back(list);
+            }
+            else
+            {
+                must_sets.push_back(EvaluateBooleanNode(nodes, clause.node, status));
+                if (must_sets.back().empty())
+                {
+                    return {};
+                }
+            }
+        }
+        else if (!is_word)
+        {
+            must_not_sets.push_back(EvaluateBooleanNode(nodes, clause.node, status));
+        }
+        else if (list != nullptr && !list->empty())
+        {
+            must_not_lists.push_back(list);
+        }
+    }
+
+    if (has_must)
+    {
+        // пересечение начинается с самого короткого операнда, чтобы проверять как можно меньше номеров
+        std::sort(must_lists.begin(), must_lists.end(), [](const PostingList *lhs, const PostingList *rhs)
+                  { return lhs->size() < rhs->size(); });
+        std::sort(must_sets.begin(), must_sets.end(), [](const std::vector<Ordinal> &lhs, const std::vector<Ordinal> &rhs)
+                  { return lhs.size() < rhs.size(); });
+        if (!must_sets.empty() && (must_lists.empty() || must_sets.front().size() <= must_lists.front()->size()))
+        {
+            result = std::move(must_sets.front());
+            must_sets.erase(must_sets.begin());
+        }
+        else
+        {
+            const std::span<const Ordinal> ordinals = must_lists.front()->GetView(decoded).ordinals;
+            result.assign(ordinals.begin(), ordinals.end());
+            must_lists.erase(must_lists.begin());
+        }
+        for (const std::vector<Ordinal> &ordinals : must_sets)
+        {
+            IntersectGalloping(result, ordinals);
+        }
+        for (const PostingList *list : must_lists)
+        {
+            FilterByPostings(result, *list, true);
+        }
+    }
+    else
+    {
+        for (const BooleanClause &clause : node.clauses)
+        {
+            if (clause.occur == Occur::SHOULD)
+            {
+                UniteSorted(result, EvaluateBooleanNode(nodes, clause.node, status));
+            }
+        }
+    }
+
+    for (const PostingList *list : must_not_lists)
+    {
+        FilterByPostings(result, *list, false);
+    }
+    for (const std::vector<Ordinal> &ordinals : must_not_sets)
+    {
+        std::vector<Ordinal> difference;
+        std::set_difference(result.begin(), result.end(), ordinals.begin(), ordinals.end(), std::back_inserter(difference));
+        result = std::move(difference);
+    }
+    return result;
+}
+
+void SearchServer::FilterByPhrases(const Query &query, std::vector<Document> &documents) const
+{
+    if (query.phrases.empty())
+    {
+        return;
+    }
+    if (!options_.store_positions)
+        throw std::logic_error("phrase query requires stored positions");
+
+    std::vector<PhraseTerms> phrases;
+    phrases.reserve(query.phrases.size());
+    for (const Phrase &phrase : query.phrases)
+    {
+        PhraseTerms terms{{}, phrase.offsets, phrase.slop};
+        for (const std::string_view word : phrase.words)
+        {
+            const TermId term = term_dictionary_.Find(word);
+            if (term == TermDictionary::NO_TERM)
+            {
+                // слова нет ни в одном документе, фраза не найдётся
+                documents.clear();
+                return;
+            }
+            terms.terms.push_back(term);
+        }
+        phrases.push_back(std::move(terms));
+    }
+
+    std::vector<std::vector<uint32_t>> positions;
+    std::erase_if(documents, [&](const Document &document)
+                  {
+                      const Ordinal ordinal = attributes_.FindOrdinal(document.id);
+                      return std::any_of(phrases.begin(), phrases.end(), [&](const PhraseTerms &phrase)
+                                         { return !ContainsPhrase(ordinal, phrase, positions); }); });
+}
+
+bool SearchServer::ContainsPhrase(Ordinal ordinal, const PhraseTerms &phrase, std::vector<std::vector<uint32_t>> &positions) const
+{
+    positions.resize(phrase.terms.size() + 1);
+    for (size_t i = 0; i < phrase.terms.size(); ++i)
+    {
+        if (!position_index_.GetPositions(ordinal, phrase.terms[i], positions[i]))
+        {
+            return false;
+        }
+    }
+
+    if (phrase.slop == 0)
+    {
+        // начала фразы: позиции первого слова, у которых остальные слова стоят на своих местах
+        std::vector<uint32_t> &starts = positions.back();
+        starts = positions.front();
+        for (size_t i = 1; i < phrase.terms.size() && !starts.empty(); ++i)
+        {
+            const uint32_t shift = phrase.offsets[i] - phrase.offsets.front();
+            auto position = positions[i].begin();
+            size_t kept = 0;
+            for (const uint32_t start : starts)
+            {
+                position = std::lower_bound(position, positions[i].end(), start + shift);
+                if (position != positions[i].end() && *position == start + shift)
+                {
+                    starts[kept++] = start;
+                }
+            }
+            starts.resize(kept);
+        }
+        return !starts.empty();
+    }
+
+    // от каждого вхождения первого слова берётся ближайшая цепочка остальных слов по порядку
+    const uint32_t max_span = phrase.offsets.back() - phrase.offsets.front() + phrase.slop;
+    for (const uint32_t start : positions.front())
+    {
+        uint32_t previous = start;
+        for (size_t i = 1; i < phrase.terms.size(); ++i)
+        {
+            const auto next = std::upper_bound(positions[i].begin(), positions[i].end(), previous);
+            if (next == positions[i].end())
+            {
+                // для следующих начал цепочка тоже не сложится
+                return false;
+            }
+            previous = *next;
+        }
+        if (previous - start <= max_span)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+const StatusPartitioned<PostingList> *SearchServer::FindPostings(const std::string_view word) const
+{
+    const TermId term = term_dictionary_.Find(word);
+    return term == TermDictionary::NO_TERM ? nullptr : &term_postings_[term];
+}
+
+void SearchServer::RequireForwardIndex() const
+{
+    if (options_.forward_index_mode == ForwardIndexMode::NONE)
+        throw std::logic_error("forward index is disabled");
+}
+
+double SearchServer::ComputeInverseDocumentFreq(const StatusPartitioned<PostingList> &postings) const
+{
+    const size_t term = &postings - term_postings_.data();
+    const size_t document_freq = postings.size() - (term < term_tombstones_.size() ? term_tombstones_[term] : 0);
+    if (document_freq == 0)
+    {
+        return 0.0; // в списках остались одни надгробия
+    }
+    return std::log(GetDocumentCount() * 1.0 / document_freq);
 }
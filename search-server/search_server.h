@@ -5,28 +5,96 @@
 #include <map>
 #include <vector>
 #include <set>
+#include <array>
+#include <span>
+#include <stdexcept>
+#include <numeric>
+#include <thread>
 #include <execution>
+#include <future>
+#include <memory>
+#include <optional>
+#include <iterator>
 #include "document.h"
+#include "document_attributes.h"
+#include "document_filter.h"
+#include "document_set.h"
+#include "executor.h"
+#include "forward_index.h"
+#include "fuzzy_term_index.h"
+#include "position_index.h"
+#include "index_stats.h"
+#include "latency_histogram.h"
+#include "posting_list.h"
+#include "relevance_accumulator.h"
+#include "result_cache.h"
+#include "search_page.h"
+#include "status_partitioned.h"
 #include "string_processing.h"
-#include "concurrent_map.h"
+#include "term_dictionary.h"
 
 const uint16_t MAX_RESULT_DOCUMENT_COUNT = 5;
 const double calculation_accuracy = 1e-6;
-const uint16_t CONCURRENT_MAP_SIZE = 100;
+const uint16_t ATTRIBUTE_BATCH_SIZE = 64;
+const size_t PARTIAL_SORT_DIVISOR = 8; // окно меньше 1/8 найденных документов выбирается частичной сортировкой
+const uint32_t MIN_SCORING_RANGE_SIZE = 4096; // меньше документов в диапазоне не стоит отдавать отдельному потоку
+const size_t MAX_BATCH_CHUNK_SIZE = 1024;      // столько запросов пакета делят один проход по спискам документов
+
+const size_t TOMBSTONE_PURGE_DIVISOR = 4; // надгробия вычищаются, когда их больше четверти живых документов
+const size_t RATING_INDEX_DIVISOR = 16;   // фильтр по рейтингу, оставляющий меньше 1/16 документов, читает индекс рейтингов
+
+/// @brief Хранение прямого индекса (слов каждого документа)
+enum class ForwardIndexMode
+{
+    IN_MEMORY,
+    /// @brief Прямого индекса нет: MatchDocument, MatchDocuments и GetWordFrequencies недоступны,
+    /// удалённые документы остаются в обратном индексе надгробиями до очистки.
+    /// Чтобы учесть надгробие в IDF, для документов хранятся только номера их слов
+    NONE,
+};
+
+/// @brief Настройки поискового сервера
+struct SearchServerOptions
+{
+    /// @brief Представление частот слов в обратном индексе. Квантованные режимы уменьшают индекс ценой ограниченной ошибки релевантности
+    TermFreqMode term_freq_mode = TermFreqMode::EXACT;
+    /// @brief Ёмкость кэша результатов FindTopDocuments с фильтром по статусу, 0 - кэш выключен
+    size_t result_cache_capacity = 0;
+    /// @brief Пул для асинхронных запросов и пакетного поиска, по умолчанию Executor::GetDefault()
+    std::shared_ptr<Executor> executor;
+    /// @brief Узлам, которые только ищут, прямой индекс не нужен, а занимает он около половины памяти
+    ForwardIndexMode forward_index_mode = ForwardIndexMode::IN_MEMORY;
+    /// @brief Хранить позиции слов. Нужны для фраз в запросе: "funny pet" - слова подряд,
+    /// "funny pet"~N - слова в том же порядке, между которыми не больше N лишних слов
+    bool store_positions = false;
+    /// @brief Во сколько слов словаря раскрывается плюс-слово с префиксом pet*: берутся слова из наибольшего
+    /// числа документов. Минус-слово с префиксом раскрывается полностью, иначе исключение было бы неполным
+    size_t max_prefix_expansions = 64;
+    /// @brief Если запрос ничего не нашёл, его плюс-слова, которых нет в индексе, заменяются похожими словами словаря
+    /// на расстоянии Левенштейна до max_fuzzy_distance (не больше FuzzyTermIndex::MAX_DISTANCE, для слов из 3-5 букв
+    /// не больше 1, короче - без замены). 0 - выключено, индекс биграмм слов не строится
+    uint32_t max_fuzzy_distance = 0;
+    /// @brief Сколько похожих слов берётся на одно слово запроса: сначала ближайшие, затем самые частые
+    size_t max_fuzzy_expansions = 4;
+    /// @brief Множитель релевантности похожего слова за каждую правку
+    double fuzzy_distance_penalty = 0.5;
+};
 
 class SearchServer
 {
 public:
     template <typename StringContainer>
-    explicit SearchServer(const StringContainer &stop_words);
-    explicit SearchServer(std::string stop_words) : SearchServer(SplitIntoWords(stop_words))
+    explicit SearchServer(const StringContainer &stop_words, const SearchServerOptions &options = {});
+    explicit SearchServer(std::string stop_words, const SearchServerOptions &options = {})
+        : SearchServer(SplitIntoWords(stop_words), options)
     {
     }
-    explicit SearchServer(std::string_view stop_words) : SearchServer(SplitIntoWords(stop_words))
+    explicit SearchServer(std::string_view stop_words, const SearchServerOptions &options = {})
+        : SearchServer(SplitIntoWords(stop_words), options)
     {
     }
 
-    /// @brief     
+    /// @brief Добавить документ в поисковую базу
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int> &ratings);
 
     std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status_query) const;
@@ -36,55 +104,109 @@ public:
     std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
     std::vector<Document> FindTopDocuments(const std::execution::sequenced_policy, const std::string_view raw_query) const;
     std::vector<Document> FindTopDocuments(const std::execution::parallel_policy, const std::string_view raw_query) const;
+    std::vector<Document> FindTopDocuments(const ExecutorPolicy &policy, const std::string_view raw_query) const;
 
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const;
     template <typename ExecutionPolicy, typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(const ExecutionPolicy &policy, const std::string_view raw_query, DocumentPredicate document_predicate) const;
 
-    int GetDocumentCount() const { return static_cast<int>(documents_.size()); }
+    /// @brief Страница выдачи в порядке FindTopDocuments, без ограничения MAX_RESULT_DOCUMENT_COUNT.
+    /// Сортируются только документы окна: после курсора и до offset + limit.
+    /// @throw std::invalid_argument если page.limit равен 0: по пустой странице не построить курсор следующей
+    SearchPage FindTopDocumentsPage(const std::string_view raw_query, const PageRequest &page,
+                                    DocumentStatus status = DocumentStatus::ACTUAL) const;
+    template <typename ExecutionPolicy, typename DocumentFilter>
+    SearchPage FindTopDocumentsPage(const ExecutionPolicy &policy, const std::string_view raw_query, const PageRequest &page,
+                                    DocumentFilter document_filter) const;
+
+    /// @brief Пакетный поиск. Результат i совпадает с FindTopDocuments(raw_queries[i], status), но запросы
+    /// обрабатываются группами: список документов слова читается и умножается на idf один раз для всех запросов группы с этим словом
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(std::span<const std::string> raw_queries,
+                                                             DocumentStatus status = DocumentStatus::ACTUAL) const;
+
+    /// @brief Асинхронный поиск в пуле сервера. Сервер не должен изменяться и разрушаться, пока результат не получен
+    std::future<std::vector<Document>> SubmitFindTopDocuments(std::string raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+    template <typename DocumentPredicate>
+    std::future<std::vector<Document>> SubmitFindTopDocuments(std::string raw_query, DocumentPredicate document_predicate) const;
+
+    /// @brief Асинхронный MatchDocument в пуле сервера, исключения передаются через future
+    std::future<std::tuple<std::vector<std::string_view>, DocumentStatus>> SubmitMatchDocument(std::string raw_query, int document_id) const;
+
+    Executor &GetExecutor() const { return options_.executor ? *options_.executor : Executor::GetDefault(); }
+
+    int GetDocumentCount() const { return static_cast<int>(attributes_.GetAliveCount()); }
+
+    /// @brief Статистика и оценка памяти индекса. Время работы линейно по числу слов словаря
+    /// @param largest_count сколько самых длинных списков документов вернуть
+    IndexStats GetIndexStats(size_t largest_count = 10) const;
+
+    /// @brief Удалённые документы, которые ещё лежат в обратном индексе (только в режиме ForwardIndexMode::NONE)
+    size_t GetTombstoneCount() const { return tombstones_.size(); }
+
+    /// @brief Вычистить надгробия из обратного индекса. Обходит все списки документов, списки обрабатываются в пуле сервера.
+    /// Вызывается и автоматически, когда надгробий становится больше 1/TOMBSTONE_PURGE_DIVISOR живых документов
+    void PurgeRemovedDocuments();
+
+    /// @brief Счётчики попаданий и промахов кэша результатов
+    ResultCacheStats GetResultCacheStats() const { return result_cache_.GetStats(); }
     auto begin() { return index2id_.begin(); }
     auto end() { return index2id_.end(); }
 
+    /// @brief Слова фраз проверяются как обычные плюс-слова, порядок слов не учитывается
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::sequenced_policy, const std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::parallel_policy, const std::string_view raw_query, int document_id) const;
 
-    /// @brief      id 
+    /// @brief MatchDocument для нескольких документов: запрос разбирается один раз, документы проверяются по политике
+    /// @throw std::out_of_range если какого-либо документа нет, до начала сопоставления
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(const std::string_view raw_query, std::span<const int> document_ids) const;
+    template <typename ExecutionPolicy>
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(const ExecutionPolicy &policy, const std::string_view raw_query,
+                                                                                          std::span<const int> document_ids) const;
+
+    /// @brief Метод получения частот слов по id документа
     /// @param document_id
-    /// @return    ,     map
-    const std::map<std::string_view, double> &GetWordFrequencies(int document_id) const;
+    /// @return Слова документа в порядке номеров слов словаря, пустое представление, если документа не существует.
+    /// Представление действительно до следующего изменения сервера
+    DocumentTerms GetWordFrequencies(int document_id) const;
 
-    /// @brief      
+    /// @brief Метод удаления документов из поискового сервера
     /// @param document_id
     void RemoveDocument(int document_id);
 
-    /// @brief      
-    /// @param policy std::execution
+    /// @brief Метод удаления документов из поискового сервера
+    /// @param policy std::execution или ExecutorPolicy
     /// @param document_id
     template <typename ExecutionPolicy>
     void RemoveDocument(const ExecutionPolicy &policy, int document_id);
 
 private:
-    struct DocumentData
-    {
-        int rating;
-        DocumentStatus status;
-    };
+    using Ordinal = DocumentAttributes::Ordinal;
+    using TermId = TermDictionary::TermId;
 
+    SearchServerOptions options_;
     std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double>> id_to_wordfreqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> index2id_;
-    std::set<std::string, std::less<>> unique_words_; //  
-
-    /// @brief            0  31        .
+    TermDictionary term_dictionary_;                            // слова документов и их номера
+    std::vector<StatusPartitioned<PostingList>> term_postings_; // обратный индекс по номеру слова
+    ForwardIndex forward_index_;                                // слова документов по порядковому номеру документа
+    TermIdIndex term_ids_;                                      // номера слов документов вместо прямого индекса в режиме NONE
+    PositionIndex position_index_;                              // позиции слов, если включены store_positions
+    FuzzyTermIndex fuzzy_index_;                                // биграммы слов словаря, если включён max_fuzzy_distance
+    DocumentAttributes attributes_;                             // рейтинги и статусы по порядковому номеру документа
+    DocumentSet index2id_;                                      // id документов, идущие подряд id хранятся интервалами
+    uint64_t generation_ = 0; // меняется при каждом изменении индекса, устаревшие записи кэша не используются
+    DocumentSet tombstones_;  // порядковые номера удалённых документов, оставшихся в обратном индексе
+    std::vector<uint32_t> term_tombstones_; // сколько надгробий в списках каждого слова, по номеру слова
+    mutable ResultCache result_cache_;
+
+    /// @brief Наличие спецсимволов — то есть символов с кодами в диапазоне от 0 до 31 включительно — в тексте документов и поискового запроса.
     static bool IsValidWord(const std::string_view word);
 
     bool IsStopWord(const std::string_view word) const { return stop_words_.count(word) > 0; }
 
-    std::vector<std::string> SplitIntoWordsNoStop(const std::string_view text) const;
+    /// @param positions если задан, сюда пишется номер каждого слова в тексте с учётом стоп-слов
+    std::vector<std::string> SplitIntoWordsNoStop(const std::string_view text, std::vector<uint32_t> *positions = nullptr) const;
 
     static int ComputeAverageRating(const std::vector<int> &ratings);
 
@@ -101,22 +223,198 @@ private:
         std::string_view data;
         bool is_minus;
         bool is_stop;
+        bool is_prefix; // pet*: data без звёздочки
     };
     QueryWordView ParseQueryWord(std::string_view text) const;
 
+    /// @brief Фраза в кавычках. Её слова входят и в плюс-слова запроса, а фраза дополнительно отбирает документы
+    struct Phrase
+    {
+        std::vector<std::string_view> words;
+        std::vector<uint32_t> offsets; // место слова во фразе, стоп-слова тоже занимают место
+        uint32_t slop = 0;             // сколько лишних слов допускается между словами фразы
+    };
+
+    /// @brief Похожее слово, подставленное вместо слова запроса с опечаткой
+    struct FuzzyWord
+    {
+        std::string_view word;
+        double weight; // множитель обратной частоты
+    };
+
+    /// @brief Как слагаемое логического выражения влияет на совпадение
+    enum class Occur
+    {
+        MUST,     // +слово, операнд AND
+        SHOULD,   // слово без оператора, операнд OR: нужно хотя бы одно, если в группе нет MUST
+        MUST_NOT, // -слово, NOT
+    };
+
+    struct BooleanClause
+    {
+        Occur occur;
+        uint32_t node;
+    };
+
+    static constexpr uint32_t NO_BOOLEAN_NODE = UINT32_MAX;
+
+    /// @brief Узел логического выражения: лист (документ содержит одно из слов, несколько - у префикса) или группа
+    struct BooleanNode
+    {
+        bool is_leaf = true;
+        std::vector<std::string_view> words;
+        std::vector<BooleanClause> clauses;
+    };
+
     struct Query
     {
         std::vector<std::string_view> plus_words;
         std::vector<std::string_view> minus_words;
+        std::vector<Phrase> phrases;
+        std::vector<FuzzyWord> fuzzy_words;
+        // корень - нулевой узел; пусто, если в запросе нет операторов и действует обычное ИЛИ плюс-слов
+        std::vector<BooleanNode> boolean_nodes;
     };
 
     Query ParseQuery(const std::string_view text, bool sort = true) const;
+    /// @brief Разбор запроса FindTopDocuments с замером QUERY_PARSE. MatchDocument и пакетный поиск
+    /// разбирают запрос через ParseQuery, чтобы их разбор не смешивался с разбором одиночного поиска
+    Query ParseSearchQuery(const std::string_view text) const;
+
+    /// @brief В запросе есть операторы AND, OR, NOT (если это не стоп-слова), +слово
+    /// или парные скобки вокруг нескольких слов
+    bool IsBooleanQuery(std::span<const std::string_view> tokens) const;
+
+    /// @brief Разбор логического запроса. AND связывает сильнее OR, соседние слова без оператора связаны OR.
+    /// Группе без утвердительных слов (только отрицания или стоп-слова), как и запросу из одних минус-слов, не соответствует ни один документ.
+    /// Плюс-слова - все слова не под отрицанием, минус-слова - отрицания верхнего уровня
+    void ParseBooleanQuery(std::span<const std::string_view> tokens, Query &query) const;
+    uint32_t ParseBooleanOr(std::span<const std::string_view> tokens, size_t &i, Query &query) const;
+    BooleanClause ParseBooleanAnd(std::span<const std::string_view> tokens, size_t &i, Query &query) const;
+    BooleanClause ParseBooleanUnary(std::span<const std::string_view> tokens, size_t &i, Query &query) const;
+
+    /// @brief Документ удовлетворяет узлу; contains(word) - есть ли слово в документе
+    template <typename Contains>
+    static bool MatchesBooleanNode(std::span<const BooleanNode> nodes, uint32_t index, Contains contains);
+
+    /// @brief Порядковые номера документов раздела status, удовлетворяющих узлу, по возрастанию.
+    /// Пересечение начинается с самого короткого обязательного операнда, остальные списки читаются курсором с пропуском
+    std::vector<Ordinal> EvaluateBooleanNode(std::span<const BooleanNode> nodes, uint32_t index, DocumentStatus status) const;
+
+    /// @brief Добавить в words слова словаря с префиксом prefix, не больше max_expansions самых частых
+    void ExpandPrefix(std::string_view prefix, size_t max_expansions, std::vector<std::string_view> &words) const;
+
+    /// @brief Разобрать фразу, которая начинается с токена first
+    /// @return номер последнего токена фразы
+    size_t ParsePhrase(std::span<const std::string_view> tokens, size_t first, Query &query) const;
+
+    /// @brief Фраза в номерах словаря
+    struct PhraseTerms
+    {
+        std::vector<TermId> terms;
+        std::vector<uint32_t> offsets;
+        uint32_t slop = 0;
+    };
+
+    /// @brief Оставить документы, содержащие все фразы запроса
+    /// @throw std::logic_error если в запросе есть фразы, а позиции не хранятся
+    void FilterByPhrases(const Query &query, std::vector<Document> &documents) const;
+
+    /// @brief Пересечение списков позиций слов фразы в документе
+    /// @param positions буферы для списков позиций
+    bool ContainsPhrase(Ordinal ordinal, const PhraseTerms &phrase, std::vector<std::vector<uint32_t>> &positions) const;
+
+    /// @brief Слова запроса в виде отсортированных номеров словаря. Слов, которых нет в словаре, нет ни в одном документе
+    struct QueryTerms
+    {
+        std::vector<TermId> plus_terms;
+        std::vector<TermId> minus_terms;
+        std::vector<BooleanNode> boolean_nodes;
+    };
+    QueryTerms MakeQueryTerms(const Query &query) const;
+
+    /// @brief Сопоставление запроса с документом: слиянием отсортированных номеров слов запроса и документа
+    /// или двоичным поиском слов запроса в документе, если запрос много короче
+    /// @throw std::out_of_range если документа нет
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchQueryTerms(const QueryTerms &query, int document_id) const;
 
-    // Existence required
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    /// @throw std::logic_error если сервер работает без прямого индекса
+    void RequireForwardIndex() const;
 
+    /// @brief Удалить из всех списков документов помеченные удалёнными
+    template <typename ExecutionPolicy>
+    void PurgeTombstones(const ExecutionPolicy &policy);
+
+    /// @brief Списки документов слова или nullptr, если слова нет в словаре
+    const StatusPartitioned<PostingList> *FindPostings(const std::string_view word) const;
+
+    /// @param postings списки документов слова из term_postings_. Надгробия в частоту документа не входят
+    double ComputeInverseDocumentFreq(const StatusPartitioned<PostingList> &postings) const;
+
+    template <typename ExecutionPolicy, typename DocumentFilter>
+    std::vector<Document> FindTopDocumentsImpl(const ExecutionPolicy &policy, const std::string_view raw_query, DocumentFilter document_filter) const;
+
+    template <typename ExecutionPolicy, typename DocumentFilter>
+    std::vector<Document> RankTopDocuments(const ExecutionPolicy &policy, const Query &query, DocumentFilter document_filter) const;
+
+    /// @brief Запрос с похожими словами вместо неизвестных плюс-слов или nullopt, если заменять нечего
+    std::optional<Query> MakeFuzzyQuery(const Query &query) const;
+
+    /// @brief Все документы запроса с учётом фраз и поиска с опечатками, без сортировки
+    template <typename ExecutionPolicy, typename DocumentFilter>
+    std::vector<Document> FindMatchedDocuments(const ExecutionPolicy &policy, const Query &query, DocumentFilter document_filter) const;
+
+    /// @brief Если result пуст и поиск с опечатками включён, повторить поиск с похожими словами
+    template <typename ExecutionPolicy, typename DocumentFilter>
+    void FindFuzzyDocuments(const ExecutionPolicy &policy, const Query &query, DocumentFilter document_filter, std::vector<Document> &result) const;
+
+    /// @brief Ключ кэша: отсортированные плюс- и минус-слова, статус и число результатов
+    static std::string MakeResultCacheKey(const Query &query, DocumentStatus status);
+
+    /// @brief Общий путь: предикат вызывается для каждого документа всех статусов
     template <typename ExecutionPolicy, typename DocumentPredicate>
     std::vector<Document> FindAllDocuments(const ExecutionPolicy &policy, const Query &query, DocumentPredicate document_predicate) const;
+
+    /// @brief Фильтр только по статусу: читается один раздел индекса, предикат не вызывается
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindAllDocuments(const ExecutionPolicy &policy, const Query &query, DocumentStatus status) const;
+
+    /// @brief Фильтр из filter::: вычисляется блоками в битовую карту кандидатов до обхода индекса.
+    /// Избирательный фильтр по рейтингу вместо этого выбирает кандидатов из индекса рейтингов, и списки слов читаются только по ним
+    template <typename ExecutionPolicy, typename Filter>
+    std::vector<Document> FindFilteredDocuments(const ExecutionPolicy &policy, const Query &query, const Filter &document_filter) const;
+
+    /// @brief Фильтр разделов, пропускающий все документы без копирования
+    struct AcceptAllPostings
+    {
+    };
+
+    /// @brief Подсчёт релевантности слиянием списков документов.
+    /// Пространство порядковых номеров делится на диапазоны, которые при параллельной политике считаются независимо,
+    /// поэтому для каждого документа слагаемые складываются в одном и том же порядке (по отсортированным плюс-словам)
+    /// @param statuses разделы индекса, которые нужно читать
+    /// @param postings_filter (status, view, ordinals, term_freqs) - копирует прошедшие фильтр документы раздела
+    /// @param candidates отсортированные порядковые номера документов, которыми ограничен поиск, nullptr - без ограничения
+    template <typename ExecutionPolicy, typename PostingsFilter>
+    std::vector<Document> ScoreDocuments(const ExecutionPolicy &policy, const Query &query, std::span<const DocumentStatus> statuses,
+                                         PostingsFilter postings_filter, const std::vector<Ordinal> *candidates = nullptr) const;
+
+    std::vector<Document> BuildMatchedDocuments(std::span<const RelevanceAccumulator> accumulators) const;
+
+    /// @brief Порядок выдачи: по убыванию релевантности, затем рейтинга, затем по возрастанию id
+    static bool IsRankedBefore(const Document &lhs, const Document &rhs);
+
+    /// @brief Отсортировать по убыванию релевантности и оставить MAX_RESULT_DOCUMENT_COUNT документов
+    template <typename ExecutionPolicy>
+    static void SelectTopDocuments(const ExecutionPolicy &policy, std::vector<Document> &documents);
+
+    /// @brief Оставить документы с offset по offset + count в порядке выдачи. Малое окно выбирается
+    /// частичной сортировкой (кучей из offset + count документов), большое - полной
+    template <typename ExecutionPolicy>
+    static void SelectDocuments(const ExecutionPolicy &policy, std::vector<Document> &documents, size_t offset, size_t count);
+
+    /// @brief Подсчёт группы запросов пакета с общим проходом по спискам документов
+    void ScoreBatchChunk(std::span<const Query> queries, DocumentStatus status, std::span<std::vector<Document>> results) const;
 };
 
 ///
@@ -124,8 +422,8 @@ private:
 ///
 
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer &stop_words)
-    : stop_words_(MakeUniqueNonEmptyStrings(stop_words))
+SearchServer::SearchServer(const StringContainer &stop_words, const SearchServerOptions &options)
+    : options_(options), stop_words_(MakeUniqueNonEmptyStrings(stop_words)), result_cache_(options.result_cache_capacity)
 {
     if (!all_of(stop_words_.cbegin(), stop_words_.cend(),
                 [](const std::string &word)
@@ -143,100 +441,466 @@ std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_
     return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
 }
 
+template <typename DocumentPredicate>
+std::future<std::vector<Document>> SearchServer::SubmitFindTopDocuments(std::string raw_query, DocumentPredicate document_predicate) const
+{
+    // запросы и так выполняются параллельно друг другу, поэтому каждый считается последовательно
+    return GetExecutor().Submit([this, raw_query = std::move(raw_query), document_predicate = std::move(document_predicate)]()
+                                { return FindTopDocuments(std::execution::seq, raw_query, document_predicate); });
+}
+
 template <typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy &policy, const std::string_view raw_query, DocumentPredicate document_predicate) const
 {
-    const Query query = ParseQuery(raw_query, true);
-    std::vector<Document> result = FindAllDocuments(policy, query, document_predicate);
-
-    std::sort(policy, result.begin(), result.end(),
-              [](const Document &lhs, const Document &rhs)
-              {
-                  if (std::abs(lhs.relevance - rhs.relevance) < calculation_accuracy)
-                  {
-                      return lhs.rating > rhs.rating;
-                  }
-                  else
-                  {
-                      return lhs.relevance > rhs.relevance;
-                  }
-              });
+    return FindTopDocumentsImpl(policy, raw_query, document_predicate);
+}
 
-    if (result.size() > MAX_RESULT_DOCUMENT_COUNT)
+template <typename ExecutionPolicy>
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(const ExecutionPolicy &policy, const std::string_view raw_query,
+                                                                                                    std::span<const int> document_ids) const
+{
+    RequireForwardIndex();
+    // стандартные параллельные алгоритмы завершают программу при исключении, поэтому id проверяются заранее
+    for (const int document_id : document_ids)
     {
-        result.resize(MAX_RESULT_DOCUMENT_COUNT);
+        if (!attributes_.Contains(document_id))
+        {
+            throw std::out_of_range{"Document id in not exsist: " + std::to_string(document_id)};
+        }
     }
+
+    const QueryTerms query = MakeQueryTerms(ParseQuery(raw_query, false));
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> result(document_ids.size());
+    // по образцу на документ, как у MatchDocument, чтобы пакет не искажал гистограмму одиночных вызовов
+    ParallelForEach(policy, document_ids.size(),
+                    [&](size_t i)
+                    {
+                        LATENCY_SCOPE(LatencyStage::MATCH_DOCUMENT);
+                        result[i] = MatchQueryTerms(query, document_ids[i]);
+                    });
     return result;
 }
 
 template <typename ExecutionPolicy>
 void SearchServer::RemoveDocument(const ExecutionPolicy &policy, int document_id)
 {
-    const std::map<std::string_view, double> &words_freqs{id_to_wordfreqs_.at(document_id)};
-
-    if (!words_freqs.empty())
+    LATENCY_SCOPE(LatencyStage::REMOVE_DOCUMENT);
+    const Ordinal ordinal = attributes_.FindOrdinal(document_id);
+    if (ordinal == DocumentAttributes::NO_ORDINAL)
+    {
+        throw std::out_of_range{"Document id in not exsist: " + std::to_string(document_id)};
+    }
+    position_index_.Remove(ordinal);
+    if (options_.forward_index_mode == ForwardIndexMode::NONE)
     {
-        std::vector<std::string_view> words{words_freqs.size()};
+        // без прямого индекса документ не убирается из списков: он помечается удалённым и пропускается при поиске.
+        // Чтобы надгробие не входило в частоту документа слова, оно учитывается в счётчиках только слов этого документа
+        term_tombstones_.resize(term_postings_.size());
+        for (const TermId term : term_ids_.Get(ordinal))
+        {
+            ++term_tombstones_[term];
+        }
+        term_ids_.Remove(ordinal);
+        attributes_.Remove(ordinal);
+        index2id_.Remove(static_cast<DocumentSet::Value>(document_id));
+        tombstones_.Add(ordinal);
+        ++generation_;
+        if (tombstones_.size() * TOMBSTONE_PURGE_DIVISOR > attributes_.GetAliveCount())
+        {
+            PurgeTombstones(policy);
+        }
+        return;
+    }
 
-        transform(policy,
-                  words_freqs.begin(), words_freqs.end(),
-                  words.begin(),
-                  [](const auto &wf)
-                  { return wf.first; });
+    const DocumentStatus status = attributes_.GetStatus(ordinal);
+    const std::span<const ForwardEntry> entries = forward_index_.Get(ordinal);
 
-        for_each(policy, words.begin(), words.end(),
-                 [this, document_id](const std::string_view &item)
-                 { word_to_document_freqs_[item].erase(document_id); });
+    if (!entries.empty())
+    {
+        std::vector<PostingList *> postings;
+        postings.reserve(entries.size());
+        for (const ForwardEntry &entry : entries)
+        {
+            postings.push_back(&term_postings_[entry.term][status]);
+        }
+
+        ParallelForEach(policy, postings.size(),
+                        [&postings, ordinal](size_t i)
+                        { postings[i]->Remove(ordinal); });
     }
 
-    documents_.erase(document_id);
-    index2id_.erase(document_id);
-    id_to_wordfreqs_.erase(document_id);
+    attributes_.Remove(ordinal);
+    index2id_.Remove(static_cast<DocumentSet::Value>(document_id));
+    forward_index_.Remove(ordinal);
+    ++generation_;
 }
 
 ///
 /// private
 ///
 
+template <typename ExecutionPolicy>
+void SearchServer::PurgeTombstones(const ExecutionPolicy &policy)
+{
+    // списки независимы, поэтому обходятся параллельно
+    ParallelForEach(policy, term_postings_.size(),
+                    [this](size_t term)
+                    {
+                        for (PostingList &postings : term_postings_[term])
+                        {
+                            postings.RemoveIf([this](Ordinal ordinal)
+                                              { return tombstones_.Contains(ordinal); });
+                        }
+                    });
+    tombstones_.clear();
+    term_tombstones_.clear();
+}
+
+template <typename ExecutionPolicy, typename DocumentFilter>
+std::vector<Document> SearchServer::FindTopDocumentsImpl(const ExecutionPolicy &policy, const std::string_view raw_query, DocumentFilter document_filter) const
+{
+    const Query query = ParseSearchQuery(raw_query);
+
+    // предикат нельзя сравнить с другим предикатом, поэтому кэшируются только запросы по статусу
+    if constexpr (std::is_same_v<DocumentFilter, DocumentStatus>)
+    {
+        if (result_cache_.IsEnabled())
+        {
+            const std::string key = MakeResultCacheKey(query, document_filter);
+            if (auto cached = result_cache_.Find(key, generation_))
+            {
+                return std::move(*cached);
+            }
+            std::vector<Document> result = RankTopDocuments(policy, query, document_filter);
+            result_cache_.Insert(key, generation_, result);
+            return result;
+        }
+    }
+    return RankTopDocuments(policy, query, document_filter);
+}
+
+template <typename ExecutionPolicy, typename DocumentFilter>
+std::vector<Document> SearchServer::RankTopDocuments(const ExecutionPolicy &policy, const Query &query, DocumentFilter document_filter) const
+{
+    std::vector<Document> result = FindMatchedDocuments(policy, query, document_filter);
+    SelectTopDocuments(policy, result);
+    return result;
+}
+
+template <typename ExecutionPolicy, typename DocumentFilter>
+SearchPage SearchServer::FindTopDocumentsPage(const ExecutionPolicy &policy, const std::string_view raw_query, const PageRequest &page,
+                                              DocumentFilter document_filter) const
+{
+    if (page.limit == 0)
+        throw std::invalid_argument("page limit must be positive");
+
+    const Query query = ParseSearchQuery(raw_query);
+    std::vector<Document> documents = FindMatchedDocuments(policy, query, document_filter);
+    if (page.after)
+    {
+        const Document last{page.after->id, page.after->relevance, page.after->rating};
+        std::erase_if(documents, [&last](const Document &document)
+                      { return !IsRankedBefore(last, document); });
+    }
+
+    const bool has_more = documents.size() - std::min(documents.size(), page.offset) > page.limit;
+    SelectDocuments(policy, documents, page.offset, page.limit);
+
+    SearchPage result;
+    if (has_more && !documents.empty())
+    {
+        result.next = SearchCursor{documents.back().relevance, documents.back().rating, documents.back().id};
+    }
+    result.documents = std::move(documents);
+    return result;
+}
+
+template <typename ExecutionPolicy, typename DocumentFilter>
+std::vector<Document> SearchServer::FindMatchedDocuments(const ExecutionPolicy &policy, const Query &query, DocumentFilter document_filter) const
+{
+    std::vector<Document> result = FindAllDocuments(policy, query, document_filter);
+    FilterByPhrases(query, result);
+    FindFuzzyDocuments(policy, query, document_filter, result);
+    return result;
+}
+
+template <typename ExecutionPolicy, typename DocumentFilter>
+void SearchServer::FindFuzzyDocuments(const ExecutionPolicy &policy, const Query &query, DocumentFilter document_filter, std::vector<Document> &result) const
+{
+    if (!result.empty() || options_.max_fuzzy_distance == 0)
+    {
+        return;
+    }
+    const std::optional<Query> fuzzy_query = MakeFuzzyQuery(query);
+    if (!fuzzy_query)
+    {
+        return;
+    }
+    result = FindAllDocuments(policy, *fuzzy_query, document_filter);
+    FilterByPhrases(*fuzzy_query, result);
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::SelectTopDocuments(const ExecutionPolicy &policy, std::vector<Document> &documents)
+{
+    SelectDocuments(policy, documents, 0, MAX_RESULT_DOCUMENT_COUNT);
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::SelectDocuments(const ExecutionPolicy &policy, std::vector<Document> &documents, size_t offset, size_t count)
+{
+    LATENCY_SCOPE(LatencyStage::QUERY_SORT);
+    const size_t window = std::min(documents.size(), offset + std::min(count, documents.size()));
+    if (window * PARTIAL_SORT_DIVISOR < documents.size())
+    {
+        std::partial_sort(documents.begin(), documents.begin() + window, documents.end(), IsRankedBefore);
+    }
+    else
+    {
+        ParallelSort(policy, documents.begin(), documents.end(), IsRankedBefore);
+    }
+    documents.resize(window);
+    documents.erase(documents.begin(), documents.begin() + std::min(offset, window));
+}
+
 template <typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindAllDocuments(const ExecutionPolicy &policy, const Query &query, DocumentPredicate document_predicate) const
 {
-    ConcurrentMap<int, double> document_to_relevance{CONCURRENT_MAP_SIZE};
-    std::for_each(policy, query.plus_words.begin(), query.plus_words.end(),
-                  [this, &document_to_relevance, &document_predicate](const std::string_view word)
-                  {
-                      if (word_to_document_freqs_.count(word))
-                      {
-                          const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                          for (const auto &[document_id, term_freq] : word_to_document_freqs_.at(word))
-                          {
-                              const auto &document_data = documents_.at(document_id);
-                              if (document_predicate(document_id, document_data.status, document_data.rating))
-                              {
-                                  document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                              }
-                          }
-                      }
-                  });
-
-    std::for_each(policy, query.minus_words.begin(), query.minus_words.end(),
-                  [this, &document_to_relevance](const std::string_view word)
-                  {
-                      if (word_to_document_freqs_.count(word))
-                      {
-                          for (const auto [document_id, _] : word_to_document_freqs_.at(word))
-                          {
-                              document_to_relevance.erase(document_id);
-                          }
-                      }
-                  });
-
-    auto ForOut = document_to_relevance.BuildOrdinaryMap();
-    std::vector<Document> matched_documents;
-    matched_documents.reserve(ForOut.size());
-    for (const auto [document_id, relevance] : ForOut)
-    {
-        matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
-    }
-    return matched_documents;
-}
\ No newline at end of file
+    if constexpr (filter::IS_FILTER<DocumentPredicate>)
+    {
+        return FindFilteredDocuments(policy, query, document_predicate);
+    }
+    else
+    {
+        return ScoreDocuments(
+            policy, query, ALL_DOCUMENT_STATUSES,
+            [this, &document_predicate](DocumentStatus status, PostingList::View postings, std::vector<Ordinal> &ordinals, std::vector<double> &term_freqs)
+            {
+                // атрибуты читаются пачками из колонок, а не через поиск по id для каждого документа
+                std::array<int32_t, ATTRIBUTE_BATCH_SIZE> ratings;
+                std::array<double, ATTRIBUTE_BATCH_SIZE> batch_freqs;
+                for (size_t first = 0; first < postings.size(); first += ATTRIBUTE_BATCH_SIZE)
+                {
+                    const size_t count = std::min<size_t>(ATTRIBUTE_BATCH_SIZE, postings.size() - first);
+                    attributes_.ReadBatch(postings.ordinals.subspan(first, count), ratings, {});
+                    postings.DecodeTermFreqs(first, count, batch_freqs.data());
+                    for (size_t i = 0; i < count; ++i)
+                    {
+                        const Ordinal ordinal = postings.ordinals[first + i];
+                        if (attributes_.IsAlive(ordinal) && document_predicate(attributes_.GetId(ordinal), status, ratings[i]))
+                        {
+                            ordinals.push_back(ordinal);
+                            term_freqs.push_back(batch_freqs[i]);
+                        }
+                    }
+                }
+            });
+    }
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindAllDocuments(const ExecutionPolicy &policy, const Query &query, DocumentStatus status) const
+{
+    return ScoreDocuments(policy, query, OnlyStatus(status), AcceptAllPostings{});
+}
+
+template <typename ExecutionPolicy, typename Filter>
+std::vector<Document> SearchServer::FindFilteredDocuments(const ExecutionPolicy &policy, const Query &query, const Filter &document_filter) const
+{
+    // если фильтр требует конкретный статус, остальные разделы индекса не читаются
+    const std::optional<DocumentStatus> required_status = document_filter.GetRequiredStatus();
+    const std::span<const DocumentStatus> statuses = required_status ? OnlyStatus(*required_status) : ALL_DOCUMENT_STATUSES;
+
+    const std::optional<filter::RatingInRange> rating_range = document_filter.GetRatingRange();
+    if (rating_range && attributes_.CountRatingRange(rating_range->first, rating_range->last) * RATING_INDEX_DIVISOR < attributes_.GetAliveCount())
+    {
+        std::vector<Ordinal> rated;
+        {
+            LATENCY_SCOPE(LatencyStage::QUERY_FILTER);
+            attributes_.FindRatingRange(rating_range->first, rating_range->last, rated);
+            std::erase_if(rated, [this, &document_filter](Ordinal ordinal)
+                          { return !document_filter(attributes_.GetId(ordinal), attributes_.GetStatus(ordinal), attributes_.GetRating(ordinal)); });
+            std::sort(rated.begin(), rated.end());
+        }
+        return ScoreDocuments(policy, query, statuses, AcceptAllPostings{}, &rated);
+    }
+
+    CandidateBitmap candidates;
+    {
+        LATENCY_SCOPE(LatencyStage::QUERY_FILTER);
+        candidates = filter::BuildCandidateBitmap(attributes_, document_filter);
+    }
+
+    return ScoreDocuments(
+        policy, query, statuses,
+        [&candidates](DocumentStatus, PostingList::View postings, std::vector<Ordinal> &ordinals, std::vector<double> &term_freqs)
+        {
+            std::array<double, ATTRIBUTE_BATCH_SIZE> batch_freqs;
+            for (size_t first = 0; first < postings.size(); first += ATTRIBUTE_BATCH_SIZE)
+            {
+                const size_t count = std::min<size_t>(ATTRIBUTE_BATCH_SIZE, postings.size() - first);
+                postings.DecodeTermFreqs(first, count, batch_freqs.data());
+                for (size_t i = 0; i < count; ++i)
+                {
+                    if (candidates.Contains(postings.ordinals[first + i]))
+                    {
+                        ordinals.push_back(postings.ordinals[first + i]);
+                        term_freqs.push_back(batch_freqs[i]);
+                    }
+                }
+            }
+        });
+}
+
+template <typename ExecutionPolicy, typename PostingsFilter>
+std::vector<Document> SearchServer::ScoreDocuments(const ExecutionPolicy &policy, const Query &query, std::span<const DocumentStatus> statuses,
+                                                   PostingsFilter postings_filter, const std::vector<Ordinal> *candidates) const
+{
+    struct PlusWord
+    {
+        const StatusPartitioned<PostingList> *postings;
+        double inverse_document_freq;
+    };
+
+    std::vector<PlusWord> plus_words;
+    for (const std::string_view word : query.plus_words)
+    {
+        const StatusPartitioned<PostingList> *postings = FindPostings(word);
+        if (postings != nullptr && postings->size() > 0)
+        {
+            plus_words.push_back({postings, ComputeInverseDocumentFreq(*postings)});
+        }
+    }
+    for (const FuzzyWord &word : query.fuzzy_words)
+    {
+        const StatusPartitioned<PostingList> &postings = *FindPostings(word.word);
+        plus_words.push_back({&postings, ComputeInverseDocumentFreq(postings) * word.weight});
+    }
+
+    const size_t ordinal_count = attributes_.GetOrdinalCount();
+
+    // документы всех минус-слов объединяются один раз, каждый диапазон исключает их одним проходом
+    DocumentSet excluded;
+    if (!query.minus_words.empty())
+    {
+        LATENCY_SCOPE(LatencyStage::QUERY_FILTER);
+        std::vector<Ordinal> decoded;
+        for (const std::string_view word : query.minus_words)
+        {
+            const StatusPartitioned<PostingList> *postings = FindPostings(word);
+            if (postings == nullptr)
+            {
+                continue;
+            }
+            for (const DocumentStatus status : statuses)
+            {
+                const PostingList::View view = (*postings)[status].Slice(0, static_cast<Ordinal>(ordinal_count), decoded);
+                if (view.empty())
+                {
+                    continue;
+                }
+                DocumentSet word_documents = DocumentSet::FromSorted(view.ordinals);
+                if (excluded.empty())
+                {
+                    excluded = std::move(word_documents);
+                }
+                else
+                {
+                    excluded |= word_documents;
+                }
+            }
+        }
+    }
+
+    size_t range_count = 1;
+    if constexpr (!std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>)
+    {
+        const size_t max_range_count = GetPolicyConcurrency(policy) * 4;
+        range_count = std::clamp<size_t>(ordinal_count / MIN_SCORING_RANGE_SIZE, 1, max_range_count);
+    }
+
+    // документы логического запроса и заданные кандидаты отбираются заранее, списки слов читаются только по этим документам
+    std::vector<std::vector<Ordinal>> status_candidates;
+    if (!query.boolean_nodes.empty() || candidates != nullptr)
+    {
+        LATENCY_SCOPE(LatencyStage::QUERY_FILTER);
+        for (const DocumentStatus status : statuses)
+        {
+            std::vector<Ordinal> &selected = status_candidates.emplace_back();
+            if (candidates != nullptr)
+            {
+                std::copy_if(candidates->begin(), candidates->end(), std::back_inserter(selected), [this, status](Ordinal ordinal)
+                             { return attributes_.GetStatus(ordinal) == status; });
+            }
+            if (!query.boolean_nodes.empty())
+            {
+                std::vector<Ordinal> matched = EvaluateBooleanNode(query.boolean_nodes, 0, status);
+                if (candidates != nullptr)
+                {
+                    matched.erase(std::set_intersection(matched.begin(), matched.end(), selected.begin(), selected.end(), matched.begin()),
+                                  matched.end());
+                }
+                selected = std::move(matched);
+            }
+        }
+    }
+
+    std::vector<RelevanceAccumulator> accumulators(range_count);
+
+    LATENCY_SCOPE(LatencyStage::QUERY_SCORE);
+    ParallelForEach(policy, range_count,
+                    [&](size_t range)
+                    {
+                        const Ordinal first = static_cast<Ordinal>(ordinal_count * range / range_count);
+                        const Ordinal last = static_cast<Ordinal>(ordinal_count * (range + 1) / range_count);
+                        RelevanceAccumulator &accumulator = accumulators[range];
+
+                        std::vector<Ordinal> decoded;
+                        std::vector<Ordinal> ordinals;
+                        std::vector<double> term_freqs;
+                        std::vector<Ordinal> gathered_ordinals;
+                        std::vector<double> gathered_freqs;
+                        const auto read_postings = [&](size_t status_index, const PostingList &list)
+                        {
+                            if (status_candidates.empty())
+                            {
+                                return list.Slice(first, last, decoded);
+                            }
+                            const std::vector<Ordinal> &selected = status_candidates[status_index];
+                            const auto begin = std::lower_bound(selected.begin(), selected.end(), first);
+                            const auto end = std::lower_bound(begin, selected.end(), last);
+                            return list.Gather(std::span<const Ordinal>{begin, end}, gathered_ordinals, gathered_freqs);
+                        };
+                        for (const PlusWord &word : plus_words)
+                        {
+                            for (size_t status_index = 0; status_index < statuses.size(); ++status_index)
+                            {
+                                const DocumentStatus status = statuses[status_index];
+                                const PostingList::View postings = read_postings(status_index, (*word.postings)[status]);
+                                if (postings.empty())
+                                {
+                                    continue;
+                                }
+
+                                if constexpr (std::is_same_v<PostingsFilter, AcceptAllPostings>)
+                                {
+                                    accumulator.MergeAdd(postings.ordinals, postings.term_freqs, word.inverse_document_freq);
+                                }
+                                else
+                                {
+                                    ordinals.clear();
+                                    term_freqs.clear();
+                                    postings_filter(status, postings, ordinals, term_freqs);
+                                    accumulator.MergeAdd(ordinals, std::span<const double>{term_freqs}, word.inverse_document_freq);
+                                }
+                            }
+                        }
+
+                        if (!excluded.empty())
+                        {
+                            accumulator.Exclude(excluded);
+                        }
+                    });
+
+    return BuildMatchedDocuments(accumulators);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <array>
+#include <span>
+#include "document.h"
+
+inline constexpr std::array<DocumentStatus, DOCUMENT_STATUS_COUNT> ALL_DOCUMENT_STATUSES{
+    DocumentStatus::ACTUAL,
+    DocumentStatus::IRRELEVANT,
+    DocumentStatus::BANNED,
+    DocumentStatus::REMOVED,
+};
+
+/// @brief Диапазон из одного статуса
+inline std::span<const DocumentStatus> OnlyStatus(DocumentStatus status)
+{
+    return {&ALL_DOCUMENT_STATUSES[static_cast<size_t>(status)], 1};
+}
+
+/// @brief Набор контейнеров, разбитый по статусу документа.
+/// Фильтр только по статусу читает один раздел и не трогает документы остальных статусов.
+template <typename Container>
+class StatusPartitioned
+{
+public:
+    Container &operator[](DocumentStatus status) { return partitions_[static_cast<size_t>(status)]; }
+    const Container &operator[](DocumentStatus status) const { return partitions_[static_cast<size_t>(status)]; }
+
+    /// @brief Суммарный размер всех разделов
+    size_t size() const
+    {
+        size_t result = 0;
+        for (const Container &partition : partitions_)
+        {
+            result += partition.size();
+        }
+        return result;
+    }
+
+    auto begin() { return partitions_.begin(); }
+    auto end() { return partitions_.end(); }
+    auto begin() const { return partitions_.begin(); }
+    auto end() const { return partitions_.end(); }
+
+private:
+    std::array<Container, DOCUMENT_STATUS_COUNT> partitions_;
+};
@@ -1,6 +1,6 @@
 #include "string_processing.h"
 
-/// @brief   ,   
+/// @brief Разбиваем на слова, игнорируем повторяющиеся пробелы
 std::vector<std::string> SplitIntoWords(const std::string_view text)
 {
     std::vector<std::string> words;
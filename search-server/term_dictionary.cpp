@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <stdexcept>
+#include "term_dictionary.h"
+
+TermDictionary::TermDictionary(const TermDictionary &other)
+    : words_(other.words_), sorted_(other.sorted_), tail_(other.tail_)
+{
+    ids_.reserve(words_.size());
+    for (TermId term = 0; term < words_.size(); ++term)
+    {
+        ids_.emplace(words_[term], term);
+    }
+}
+
+TermDictionary &TermDictionary::operator=(const TermDictionary &other)
+{
+    if (this != &other)
+    {
+        *this = TermDictionary(other);
+    }
+    return *this;
+}
+
+TermDictionary::TermId TermDictionary::Add(std::string_view word)
+{
+    const auto it = ids_.find(word);
+    if (it != ids_.end())
+    {
+        return it->second;
+    }
+
+    if (words_.size() >= NO_TERM)
+        throw std::length_error("too many terms");
+
+    const TermId term = static_cast<TermId>(words_.size());
+    words_.emplace_back(word);
+    ids_.emplace(words_.back(), term);
+    tail_.push_back(term);
+    if (tail_.size() > std::max(MIN_SORTED_TAIL, sorted_.size() / SORTED_TAIL_DIVISOR))
+    {
+        MergeTail();
+    }
+    return term;
+}
+
+TermDictionary::TermId TermDictionary::Find(std::string_view word) const
+{
+    const auto it = ids_.find(word);
+    return it == ids_.end() ? NO_TERM : it->second;
+}
+
+void TermDictionary::FindPrefix(std::string_view prefix, std::vector<TermId> &out) const
+{
+    const auto first = std::partition_point(sorted_.begin(), sorted_.end(), [this, prefix](TermId term)
+                                            { return words_[term] < prefix; });
+    for (auto it = first; it != sorted_.end() && words_[*it].starts_with(prefix); ++it)
+    {
+        out.push_back(*it);
+    }
+    for (const TermId term : tail_)
+    {
+        if (words_[term].starts_with(prefix))
+        {
+            out.push_back(term);
+        }
+    }
+}
+
+size_t TermDictionary::GetMemoryUsage() const
+{
+    // узел unordered_map: указатель на следующий узел, пара и закэшированный хэш
+    const size_t node_size = sizeof(void *) + sizeof(std::pair<const std::string_view, TermId>) + sizeof(size_t);
+    size_t bytes = words_.size() * sizeof(std::string) + ids_.bucket_count() * sizeof(void *) + ids_.size() * node_size +
+                   (sorted_.capacity() + tail_.capacity()) * sizeof(TermId);
+    for (const std::string &word : words_)
+    {
+        // короткие строки хранятся внутри объекта
+        if (word.capacity() > std::string{}.capacity())
+        {
+            bytes += word.capacity() + 1;
+        }
+    }
+    return bytes;
+}
+
+void TermDictionary::MergeTail()
+{
+    const auto by_word = [this](TermId lhs, TermId rhs)
+    {
+        return words_[lhs] < words_[rhs];
+    };
+    std::sort(tail_.begin(), tail_.end(), by_word);
+    const size_t middle = sorted_.size();
+    sorted_.insert(sorted_.end(), tail_.begin(), tail_.end());
+    std::inplace_merge(sorted_.begin(), sorted_.begin() + middle, sorted_.end(), by_word);
+    tail_.clear();
+}
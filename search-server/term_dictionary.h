@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/// @brief Словарь слов документов: каждому слову выдаётся плотный номер в порядке первого появления.
+/// Строки хранятся в словаре, string_view на них действительны всё время жизни словаря.
+/// Для поиска по префиксу номера слов хранятся ещё и в алфавитном порядке: новые слова копятся в коротком
+/// хвосте и вливаются в отсортированную часть, когда хвост вырастает до доли от неё
+class TermDictionary
+{
+public:
+    using TermId = uint32_t;
+
+    static constexpr TermId NO_TERM = UINT32_MAX;
+    /// @brief Хвост вливается в отсортированную часть, когда превышает её долю 1/SORTED_TAIL_DIVISOR
+    static constexpr size_t SORTED_TAIL_DIVISOR = 8;
+    static constexpr size_t MIN_SORTED_TAIL = 64;
+
+    TermDictionary() = default;
+    // ключи хэш-таблицы ссылаются на строки своего словаря, поэтому при копировании таблица строится заново
+    TermDictionary(const TermDictionary &other);
+    TermDictionary &operator=(const TermDictionary &other);
+    TermDictionary(TermDictionary &&) = default;
+    TermDictionary &operator=(TermDictionary &&) = default;
+
+    /// @brief Номер слова, новое слово добавляется в словарь
+    TermId Add(std::string_view word);
+
+    /// @brief Номер слова или NO_TERM, если слова нет
+    TermId Find(std::string_view word) const;
+
+    /// @brief Номера всех слов, начинающихся с prefix, в out. Порядок не определён
+    void FindPrefix(std::string_view prefix, std::vector<TermId> &out) const;
+
+    std::string_view GetWord(TermId term) const { return words_[term]; }
+
+    size_t size() const { return words_.size(); }
+
+    /// @brief Приблизительный объём занятой динамической памяти
+    size_t GetMemoryUsage() const;
+
+private:
+    std::deque<std::string> words_; // по номеру слова, deque не перемещает строки при росте
+    std::unordered_map<std::string_view, TermId> ids_;
+    std::vector<TermId> sorted_; // номера слов в алфавитном порядке
+    std::vector<TermId> tail_;   // новые слова, ещё не влитые в sorted_
+
+    void MergeTail();
+};
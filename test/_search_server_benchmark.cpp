@@ -0,0 +1,424 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <execution>
+#include <iostream>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "..\search-server\src\search_server.h"
+#include "..\search-server\src\process_queries.h"
+#include "..\search-server\src\remove_duplicates.h"
+#include "..\search-server\src\latency_histogram.h"
+#include "..\search-server\src\executor.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+// Нагрузочные замеры поискового сервера на синтетическом корпусе.
+// Слова документов и запросов распределены по закону Ципфа, корпус полностью определяется параметрами и seed,
+// поэтому запуски на разных версиях сравнимы. Каждый замер печатается одной строкой JSON.
+//
+// Параметры: --documents N --queries N --vocabulary N --document-words N --query-words N
+//            --zipf S --match-documents N --remove-documents N --seed N
+
+struct BenchmarkConfig
+{
+    size_t documents = 10'000;
+    size_t queries = 10'000;
+    size_t vocabulary = 20'000;
+    size_t document_words = 50; // средняя длина документа, реальная длина от половины до полутора
+    size_t query_words = 5;
+    double zipf = 1.0;
+    size_t match_documents = 1'000;
+    size_t remove_documents = 1'000;
+    unsigned seed = 42;
+};
+
+BenchmarkConfig ParseConfig(int argc, char **argv)
+{
+    BenchmarkConfig config;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const string_view name = argv[i];
+        const char *value = argv[i + 1];
+        if (name == "--documents"sv)
+            config.documents = strtoull(value, nullptr, 10);
+        else if (name == "--queries"sv)
+            config.queries = strtoull(value, nullptr, 10);
+        else if (name == "--vocabulary"sv)
+            config.vocabulary = strtoull(value, nullptr, 10);
+        else if (name == "--document-words"sv)
+            config.document_words = strtoull(value, nullptr, 10);
+        else if (name == "--query-words"sv)
+            config.query_words = strtoull(value, nullptr, 10);
+        else if (name == "--zipf"sv)
+            config.zipf = strtod(value, nullptr);
+        else if (name == "--match-documents"sv)
+            config.match_documents = strtoull(value, nullptr, 10);
+        else if (name == "--remove-documents"sv)
+            config.remove_documents = strtoull(value, nullptr, 10);
+        else if (name == "--seed"sv)
+            config.seed = static_cast<unsigned>(strtoul(value, nullptr, 10));
+        else
+            throw invalid_argument("unknown option "s + string(name));
+    }
+    return config;
+}
+
+/// @brief Генератор слов с вероятностью слова ранга k, пропорциональной 1 / k^s
+class ZipfCorpus
+{
+public:
+    ZipfCorpus(mt19937 &generator, size_t vocabulary, double exponent)
+    {
+        words_.reserve(vocabulary);
+        for (size_t rank = 0; rank < vocabulary; ++rank)
+        {
+            // ранг входит в слово, поэтому слова различны
+            string word = to_string(rank);
+            const int padding = uniform_int_distribution(1, 8)(generator);
+            for (int i = 0; i < padding; ++i)
+            {
+                word.push_back(uniform_int_distribution<int>('a', 'z')(generator));
+            }
+            words_.push_back(move(word));
+        }
+
+        cumulative_.reserve(vocabulary);
+        double total = 0;
+        for (size_t rank = 1; rank <= vocabulary; ++rank)
+        {
+            total += 1.0 / pow(static_cast<double>(rank), exponent);
+            cumulative_.push_back(total);
+        }
+    }
+
+    const string &NextWord(mt19937 &generator) const
+    {
+        const double point = uniform_real_distribution<>(0, cumulative_.back())(generator);
+        const size_t rank = lower_bound(cumulative_.begin(), cumulative_.end(), point) - cumulative_.begin();
+        return words_[min(rank, words_.size() - 1)];
+    }
+
+    string NextText(mt19937 &generator, size_t word_count, double minus_prob = 0) const
+    {
+        string text;
+        for (size_t i = 0; i < word_count; ++i)
+        {
+            if (!text.empty())
+            {
+                text.push_back(' ');
+            }
+            if (minus_prob > 0 && uniform_real_distribution<>(0, 1)(generator) < minus_prob)
+            {
+                text.push_back('-');
+            }
+            text += NextWord(generator);
+        }
+        return text;
+    }
+
+    const string &GetStopWord() const { return words_.front(); }
+
+private:
+    vector<string> words_;
+    vector<double> cumulative_;
+};
+
+size_t GetPeakRssKilobytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.PeakWorkingSetSize / 1024;
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<size_t>(usage.ru_maxrss);
+#endif
+}
+
+/// @brief Замер серии операций: время каждой операции попадает в гистограмму
+class Benchmark
+{
+public:
+    explicit Benchmark(string name) : name_(move(name)) {}
+
+    template <typename Operation>
+    void Measure(Operation operation)
+    {
+        const auto start = chrono::steady_clock::now();
+        operation();
+        const auto duration = chrono::steady_clock::now() - start;
+        histogram_.Record(duration);
+        total_ += duration;
+    }
+
+    /// @param items сколько элементов (запросов, документов) обработано за все операции
+    void Report(size_t items) const
+    {
+        const double seconds = chrono::duration<double>(total_).count();
+        const auto microseconds = [this](double quantile)
+        {
+            return chrono::duration<double, micro>(histogram_.GetPercentile(quantile)).count();
+        };
+        cout << "{\"name\":\""s << name_ << "\""s
+             << ",\"operations\":"s << histogram_.GetCount()
+             << ",\"items\":"s << items
+             << ",\"seconds\":"s << seconds
+             << ",\"items_per_second\":"s << (seconds > 0 ? items / seconds : 0)
+             << ",\"p50_us\":"s << microseconds(0.5)
+             << ",\"p90_us\":"s << microseconds(0.9)
+             << ",\"p99_us\":"s << microseconds(0.99)
+             << ",\"max_us\":"s << chrono::duration<double, micro>(histogram_.GetMax()).count()
+             << ",\"peak_rss_kb\":"s << GetPeakRssKilobytes()
+             << "}"s << endl;
+    }
+
+private:
+    string name_;
+    LatencyHistogram histogram_;
+    chrono::steady_clock::duration total_{};
+};
+
+template <typename ExecutionPolicy>
+void BenchmarkFindTopDocuments(const string &name, const SearchServer &search_server, const vector<string> &queries, ExecutionPolicy policy)
+{
+    Benchmark benchmark(name);
+    size_t found = 0;
+    for (const string &query : queries)
+    {
+        benchmark.Measure([&]()
+                          { found += search_server.FindTopDocuments(policy, query).size(); });
+    }
+    benchmark.Report(queries.size());
+    cerr << name << " found: "s << found << endl;
+}
+
+template <typename ExecutionPolicy>
+void BenchmarkMatchDocument(const string &name, const SearchServer &search_server, const vector<string> &queries,
+                            const vector<int> &document_ids, ExecutionPolicy policy)
+{
+    Benchmark benchmark(name);
+    size_t matched = 0;
+    for (size_t i = 0; i < document_ids.size(); ++i)
+    {
+        const string &query = queries[i % queries.size()];
+        benchmark.Measure([&]()
+                          { matched += get<0>(search_server.MatchDocument(policy, query, document_ids[i])).size(); });
+    }
+    benchmark.Report(document_ids.size());
+    cerr << name << " matched: "s << matched << endl;
+}
+
+template <typename ExecutionPolicy>
+void BenchmarkRemoveDocument(const string &name, SearchServer &search_server, const vector<int> &document_ids, ExecutionPolicy policy)
+{
+    Benchmark benchmark(name);
+    for (const int document_id : document_ids)
+    {
+        benchmark.Measure([&]()
+                          { search_server.RemoveDocument(policy, document_id); });
+    }
+    benchmark.Report(document_ids.size());
+}
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        const BenchmarkConfig config = ParseConfig(argc, argv);
+        mt19937 generator(config.seed);
+        const ZipfCorpus corpus(generator, config.vocabulary, config.zipf);
+
+        vector<string> documents;
+        documents.reserve(config.documents);
+        for (size_t i = 0; i < config.documents; ++i)
+        {
+            const size_t word_count = uniform_int_distribution<size_t>(config.document_words / 2 + 1, config.document_words * 3 / 2 + 1)(generator);
+            documents.push_back(corpus.NextText(generator, word_count));
+        }
+        vector<string> queries;
+        queries.reserve(config.queries);
+        for (size_t i = 0; i < config.queries; ++i)
+        {
+            const size_t word_count = uniform_int_distribution<size_t>(1, config.query_words)(generator);
+            queries.push_back(corpus.NextText(generator, word_count, 0.1));
+        }
+
+        SearchServer search_server(corpus.GetStopWord());
+        {
+            Benchmark benchmark("add_document"s);
+            for (size_t i = 0; i < documents.size(); ++i)
+            {
+                benchmark.Measure([&]()
+                                  { search_server.AddDocument(static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {static_cast<int>(i % 100)}); });
+            }
+            benchmark.Report(documents.size());
+        }
+
+        BenchmarkFindTopDocuments("find_top_documents_seq"s, search_server, queries, execution::seq);
+        BenchmarkFindTopDocuments("find_top_documents_par"s, search_server, queries, execution::par);
+        BenchmarkFindTopDocuments("find_top_documents_executor"s, search_server, queries, Executor::GetDefault().Policy());
+        {
+            // поиск по мере набора: последнее слово запроса набрано наполовину
+            vector<string> prefix_queries;
+            prefix_queries.reserve(queries.size());
+            for (const string &query : queries)
+            {
+                size_t last_word = query.find_last_of(' ') + 1;
+                if (query[last_word] == '-')
+                {
+                    ++last_word;
+                }
+                const size_t typed = max<size_t>(1, (query.size() - last_word) / 2);
+                prefix_queries.push_back(query.substr(0, last_word + typed) + "*"s);
+            }
+            BenchmarkFindTopDocuments("find_top_documents_prefix"s, search_server, prefix_queries, execution::seq);
+        }
+        {
+            // все слова запроса обязательны: документы отбираются пересечением от самого редкого слова
+            vector<string> required_queries;
+            required_queries.reserve(queries.size());
+            for (const string &query : queries)
+            {
+                string required;
+                for (const string_view word : SplitIntoWordsView(query))
+                {
+                    required += word[0] == '-' ? ""s : "+"s;
+                    required += word;
+                    required += ' ';
+                }
+                required.pop_back();
+                required_queries.push_back(move(required));
+            }
+            BenchmarkFindTopDocuments("find_top_documents_required"s, search_server, required_queries, execution::seq);
+        }
+        {
+            // избирательный фильтр по рейтингу: предикат проверяется для каждого документа списков,
+            // фильтр из filter:: выбирает кандидатов по индексу рейтингов
+            Benchmark predicate_benchmark("find_top_documents_rating_predicate"s);
+            Benchmark filter_benchmark("find_top_documents_rating_filter"s);
+            size_t predicate_found = 0;
+            size_t filter_found = 0;
+            for (const string &query : queries)
+            {
+                predicate_benchmark.Measure([&]()
+                                            { predicate_found += search_server.FindTopDocuments(query, [](int, DocumentStatus, int rating)
+                                                                                                { return rating >= 99; })
+                                                                     .size(); });
+                filter_benchmark.Measure([&]()
+                                         { filter_found += search_server.FindTopDocuments(query, filter::RatingAtLeast{99}).size(); });
+            }
+            predicate_benchmark.Report(queries.size());
+            filter_benchmark.Report(queries.size());
+            cerr << "find_top_documents_rating found: "s << predicate_found << " / "s << filter_found << endl;
+        }
+        {
+            // глубокая страница: 50-я страница по 20 документов
+            PageRequest page;
+            page.offset = 49 * DEFAULT_PAGE_SIZE;
+            Benchmark benchmark("find_top_documents_page"s);
+            size_t found = 0;
+            for (const string &query : queries)
+            {
+                benchmark.Measure([&]()
+                                  { found += search_server.FindTopDocumentsPage(query, page).documents.size(); });
+            }
+            benchmark.Report(queries.size());
+            cerr << "find_top_documents_page found: "s << found << endl;
+        }
+
+        vector<int> match_ids;
+        for (size_t i = 0; i < config.match_documents; ++i)
+        {
+            match_ids.push_back(uniform_int_distribution<int>(0, static_cast<int>(config.documents) - 1)(generator));
+        }
+        BenchmarkMatchDocument("match_document_seq"s, search_server, queries, match_ids, execution::seq);
+        BenchmarkMatchDocument("match_document_par"s, search_server, queries, match_ids, execution::par);
+        {
+            // подсветка страницы результатов: один запрос сопоставляется с несколькими документами
+            const size_t page_size = MAX_RESULT_DOCUMENT_COUNT;
+            Benchmark benchmark("match_documents_page"s);
+            size_t matched = 0;
+            for (size_t first = 0; first < match_ids.size(); first += page_size)
+            {
+                const span<const int> page = span<const int>{match_ids}.subspan(first, min(page_size, match_ids.size() - first));
+                benchmark.Measure([&]()
+                                  {
+                                      for (const auto &[words, status] : search_server.MatchDocuments(queries[first % queries.size()], page))
+                                      {
+                                          matched += words.size();
+                                      } });
+            }
+            benchmark.Report(match_ids.size());
+            cerr << "match_documents_page matched: "s << matched << endl;
+        }
+
+        {
+            Benchmark benchmark("process_queries"s);
+            benchmark.Measure([&]()
+                              { ProcessQueries(search_server, queries); });
+            benchmark.Report(queries.size());
+        }
+        {
+            Benchmark benchmark("process_queries_joined"s);
+            benchmark.Measure([&]()
+                              { ProcessQueriesJoined(search_server, queries); });
+            benchmark.Report(queries.size());
+        }
+        {
+            Benchmark benchmark("process_queries_streaming"s);
+            size_t found = 0;
+            benchmark.Measure([&]()
+                              { ProcessQueriesStreaming(search_server, queries, [&found](size_t, span<const Document> documents)
+                                                        { found += documents.size(); }); });
+            benchmark.Report(queries.size());
+        }
+
+        {
+            Benchmark benchmark("remove_duplicates"s);
+            const int before = search_server.GetDocumentCount();
+            // RemoveDuplicates печатает найденные дубликаты в cout, а cout занят строками замеров
+            streambuf *const output = cout.rdbuf(cerr.rdbuf());
+            benchmark.Measure([&]()
+                              { RemoveDuplicates(search_server); });
+            cout.rdbuf(output);
+            benchmark.Report(static_cast<size_t>(before));
+        }
+
+        // удаляются разные документы, чтобы seq и par работали с индексом одного размера
+        vector<int> remove_seq_ids;
+        vector<int> remove_par_ids;
+        for (const int document_id : search_server)
+        {
+            if (remove_seq_ids.size() >= config.remove_documents && remove_par_ids.size() >= config.remove_documents)
+            {
+                break;
+            }
+            vector<int> &ids = document_id % 2 == 0 ? remove_seq_ids : remove_par_ids;
+            if (ids.size() < config.remove_documents)
+            {
+                ids.push_back(document_id);
+            }
+        }
+        BenchmarkRemoveDocument("remove_document_seq"s, search_server, remove_seq_ids, execution::seq);
+        BenchmarkRemoveDocument("remove_document_par"s, search_server, remove_par_ids, execution::par);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -3,6 +3,9 @@
 #include <string>
 #include <vector>
 #include <cmath>
+#include <atomic>
+#include <thread>
+#include <chrono>
 #include "..\search-server\src\search_server.h"
 
 #include "..\search-server\src\process_queries.h"
@@ -10,6 +13,11 @@
 #include "..\search-server\src\paginator.h"
 #include "..\search-server\src\remove_duplicates.h"
 #include "..\search-server\src\request_queue.h"
+#include "..\search-server\src\document_attributes.h"
+#include "..\search-server\src\document_set.h"
+#include "..\search-server\src\scoring_kernel.h"
+#include "..\search-server\src\latency_histogram.h"
+#include "..\search-server\src\executor.h"
 #include "test_runner.h"
 
 using namespace std;
@@ -550,6 +558,68 @@ void TestRequestQueue()
     ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1437);
 }
 
+void TestRequestQueueSharedByThreads()
+{
+    SearchServer server("and on at"s);
+    server.AddDocument(1, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+
+    atomic<uint64_t> minute{100};
+    RequestQueue request_queue(server, [&minute]()
+                               { return minute.load(); });
+
+    vector<thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&request_queue]()
+                             {
+                                 for (int i = 0; i < 500; ++i)
+                                 {
+                                     request_queue.AddFindRequest(i % 5 == 0 ? "cat"s : "empty request"s);
+                                 } });
+    }
+    for (thread &th : threads)
+    {
+        th.join();
+    }
+
+    RequestStats stats = request_queue.GetStats();
+    ASSERT_EQUAL(stats.requests, 2000u);
+    ASSERT_EQUAL(stats.no_result_requests, 1600u);
+    ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1600);
+
+    minute += 1439;
+    request_queue.AddFindRequest("cat"s);
+    ASSERT_EQUAL(request_queue.GetStats().requests, 2001u);
+
+    // минута 100 вышла из окна
+    minute += 1;
+    request_queue.AddFindRequest("cat"s);
+    stats = request_queue.GetStats();
+    ASSERT_EQUAL(stats.requests, 2u);
+    ASSERT_EQUAL(stats.no_result_requests, 0u);
+
+    // без часов каждый запрос - новая минута, и потоки постоянно переводят корзины на новый круг:
+    // в окне остаются ровно последние min_in_day минут, запросы выпавших минут не попадают в чужие корзины
+    RequestQueue rotating_queue(server);
+    threads.clear();
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&rotating_queue]()
+                             {
+                                 for (int i = 0; i < 1000; ++i)
+                                 {
+                                     rotating_queue.AddFindRequest("cat"s);
+                                 } });
+    }
+    for (thread &th : threads)
+    {
+        th.join();
+    }
+    stats = rotating_queue.GetStats();
+    ASSERT_EQUAL(stats.requests, 1440u);
+    ASSERT_EQUAL(stats.no_result_requests, 0u);
+}
+
 void TestRemoveDuplicates()
 {
     SearchServer server("and with"s);
@@ -659,6 +729,1297 @@ void TestProcessQueriesJoined()
     result.erase(result.begin(), result.begin() + 1);
 }
 
+void TestProcessQueriesStreaming()
+{
+    SearchServer search_server("and with"s);
+    for (int id = 0; const string &text : {
+                         "funny pet and nasty rat"s,
+                         "funny pet with curly hair"s,
+                         "funny pet and not very nasty rat"s,
+                         "pet with rat and rat and rat"s,
+                         "nasty rat with curly hair"s,
+                     })
+    {
+        search_server.AddDocument(++id, text, DocumentStatus::ACTUAL, {1, 2});
+    }
+    const vector<string> queries = {"nasty rat -not"s, "not very funny nasty pet"s, "curly hair"s, "dog"s};
+
+    const auto expected = ProcessQueries(search_server, queries);
+    size_t next_index = 0;
+    ProcessQueriesStreaming(search_server, queries, [&](size_t query_index, span<const Document> documents)
+                            {
+                                ASSERT_EQUAL(query_index, next_index++);
+                                ASSERT_EQUAL(documents.size(), expected[query_index].size());
+                                for (size_t i = 0; i < documents.size(); ++i)
+                                {
+                                    ASSERT_EQUAL(documents[i].id, expected[query_index][i].id);
+                                } });
+    ASSERT_EQUAL(next_index, queries.size());
+}
+
+void TestMatchDocuments()
+{
+    SearchServer search_server("and with"s);
+    for (int id = 0; const string &text : {
+                         "funny pet and nasty rat"s,
+                         "funny pet with curly hair"s,
+                         "funny pet and not very nasty rat"s,
+                         "pet with rat and rat and rat"s,
+                         "nasty rat with curly hair"s,
+                     })
+    {
+        search_server.AddDocument(++id, text, DocumentStatus::ACTUAL, {1, 2});
+    }
+
+    const string query = "curly and funny -not rat rat"s;
+    const vector<int> ids = {5, 3, 1, 2, 4};
+    const auto seq = search_server.MatchDocuments(query, ids);
+    const auto par = search_server.MatchDocuments(execution::par, query, ids);
+    ASSERT_EQUAL(seq.size(), ids.size());
+    for (size_t i = 0; i < ids.size(); ++i)
+    {
+        const auto [words, status] = search_server.MatchDocument(query, ids[i]);
+        ASSERT_EQUAL(get<0>(seq[i]), words);
+        ASSERT_EQUAL(get<0>(par[i]), words);
+        ASSERT(get<1>(seq[i]) == status);
+    }
+    ASSERT_EQUAL(get<0>(seq[0]), (vector<string_view>{"curly"sv, "rat"sv}));
+    ASSERT(get<0>(seq[1]).empty());
+    ASSERT_EQUAL(get<0>(seq[2]), (vector<string_view>{"funny"sv, "rat"sv}));
+
+    // в длинном документе слова короткого запроса ищутся по одному, а не слиянием
+    string long_text = "curly rat"s;
+    for (int i = 0; i < 100; ++i)
+    {
+        long_text += " w"s + to_string(i);
+    }
+    search_server.AddDocument(6, long_text, DocumentStatus::BANNED, {1});
+    const vector<int> long_ids = {6};
+    const auto [long_words, long_status] = search_server.MatchDocuments(execution::par, "rat curly -dog"s, long_ids).front();
+    ASSERT_EQUAL(long_words, (vector<string_view>{"curly"sv, "rat"sv}));
+    ASSERT(long_status == DocumentStatus::BANNED);
+    ASSERT(get<0>(search_server.MatchDocuments("rat -w5"s, long_ids).front()).empty());
+
+    bool thrown = false;
+    try
+    {
+        const vector<int> missing = {1, 100};
+        search_server.MatchDocuments(execution::par, query, missing);
+    }
+    catch (const out_of_range &)
+    {
+        thrown = true;
+    }
+    ASSERT(thrown);
+}
+
+void TestAsyncQueries()
+{
+    SearchServerOptions options;
+    options.executor = make_shared<Executor>(3);
+    SearchServer search_server("and with"s, options);
+    for (int id = 0; const string &text : {
+                         "funny pet and nasty rat"s,
+                         "funny pet with curly hair"s,
+                         "funny pet and not very nasty rat"s,
+                         "pet with rat and rat and rat"s,
+                         "nasty rat with curly hair"s,
+                     })
+    {
+        ++id;
+        search_server.AddDocument(id, text, id % 2 == 0 ? DocumentStatus::ACTUAL : DocumentStatus::BANNED, {id, 2});
+    }
+    const vector<string> queries = {"nasty rat -not"s, "not very funny nasty pet"s, "curly hair"s, "dog"s};
+
+    vector<future<vector<Document>>> found;
+    vector<future<vector<Document>>> banned;
+    for (const string &query : queries)
+    {
+        found.push_back(search_server.SubmitFindTopDocuments(query));
+        banned.push_back(search_server.SubmitFindTopDocuments(query, [](int, DocumentStatus status, int)
+                                                              { return status == DocumentStatus::BANNED; }));
+    }
+    for (size_t i = 0; i < queries.size(); ++i)
+    {
+        const auto expected = search_server.FindTopDocuments(queries[i]);
+        const auto result = found[i].get();
+        ASSERT_EQUAL(result.size(), expected.size());
+        for (size_t j = 0; j < result.size(); ++j)
+        {
+            ASSERT_EQUAL(result[j].id, expected[j].id);
+        }
+        ASSERT_EQUAL(banned[i].get().size(), search_server.FindTopDocuments(queries[i], DocumentStatus::BANNED).size());
+    }
+
+    const auto [words, status] = search_server.SubmitMatchDocument("curly -dog hair"s, 2).get();
+    ASSERT_EQUAL(words, get<0>(search_server.MatchDocument("curly -dog hair"s, 2)));
+    ASSERT(status == DocumentStatus::ACTUAL);
+
+    bool thrown = false;
+    auto missing = search_server.SubmitMatchDocument("curly"s, 100);
+    try
+    {
+        missing.get();
+    }
+    catch (const out_of_range &)
+    {
+        thrown = true;
+    }
+    ASSERT(thrown);
+
+    // вложенный ParallelFor выполняется теми же потоками и не блокирует пул
+    atomic<int> visited = 0;
+    options.executor->ParallelFor(8, [&](size_t)
+                                  { options.executor->ParallelFor(8, [&](size_t)
+                                                                  { ++visited; }); });
+    ASSERT_EQUAL(visited.load(), 64);
+}
+
+void TestExecutorPolicy()
+{
+    ExecutorOptions executor_options;
+    executor_options.thread_count = 2;
+    executor_options.cpu_affinity = {0};
+    Executor executor(executor_options);
+    ASSERT_EQUAL(executor.GetThreadCount(), 2u);
+
+    // номер процессора за пределами маски привязки не принимается
+    ExecutorOptions wrong_options = executor_options;
+    wrong_options.cpu_affinity = {0, 1'000'000};
+    string exString{};
+    try
+    {
+        Executor wrong_executor(wrong_options);
+    }
+    catch (const invalid_argument &e)
+    {
+        exString = e.what();
+    }
+    ASSERT(!exString.empty());
+
+    SearchServer search_server("and with"s);
+    mt19937 generator(7);
+    const vector<string> words = {"funny"s, "pet"s, "nasty"s, "rat"s, "curly"s, "hair"s, "dog"s, "cat"s};
+    for (int id = 0; id < 20'000; ++id)
+    {
+        string text;
+        for (int i = 0; i < 4; ++i)
+        {
+            text += words[uniform_int_distribution<size_t>(0, words.size() - 1)(generator)] + " "s;
+        }
+        text += "w"s + to_string(id);
+        search_server.AddDocument(id, text, id % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {id % 17});
+    }
+
+    for (const string &query : {"funny nasty -dog"s, "curly hair cat"s, "pet rat -funny"s})
+    {
+        const auto expected = search_server.FindTopDocuments(execution::seq, query);
+        const auto result = search_server.FindTopDocuments(executor.Policy(), query);
+        ASSERT_EQUAL(result.size(), expected.size());
+        for (size_t i = 0; i < result.size(); ++i)
+        {
+            ASSERT_EQUAL(result[i].id, expected[i].id);
+        }
+        const auto banned = search_server.FindTopDocuments(executor.Policy(), query, DocumentStatus::BANNED);
+        ASSERT_EQUAL(banned.front().id, search_server.FindTopDocuments(query, DocumentStatus::BANNED).front().id);
+        const auto even = search_server.FindTopDocuments(executor.Policy(), query, [](int id, DocumentStatus, int)
+                                                         { return id % 2 == 0; });
+        ASSERT_EQUAL(even.front().id, search_server.FindTopDocuments(query, [](int id, DocumentStatus, int)
+                                                                     { return id % 2 == 0; })
+                                          .front()
+                                          .id);
+    }
+
+    // большой массив сортируется частями на пуле
+    vector<int> values(50'000);
+    for (int &value : values)
+    {
+        value = uniform_int_distribution(0, 1'000'000)(generator);
+    }
+    ParallelSort(executor.Policy(), values.begin(), values.end(), less<int>{});
+    ASSERT(is_sorted(values.begin(), values.end()));
+    // par сортирует тем же способом на общем пуле
+    ParallelSort(execution::par, values.begin(), values.end(), greater<int>{});
+    ASSERT(is_sorted(values.begin(), values.end(), greater<int>{}));
+
+    for (int id = 0; id < 20'000; id += 2)
+    {
+        search_server.RemoveDocument(executor.Policy(), id);
+    }
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 10'000);
+    for (const Document &document : search_server.FindTopDocuments(executor.Policy(), "funny pet"s))
+    {
+        ASSERT_EQUAL(document.id % 2, 1);
+    }
+}
+
+void TestDocumentAttributes()
+{
+    DocumentAttributes attributes;
+    const auto first = attributes.Add(7, 5, DocumentStatus::ACTUAL);
+    const auto second = attributes.Add(3, -2, DocumentStatus::BANNED);
+    const auto third = attributes.Add(11, 9, DocumentStatus::REMOVED);
+
+    attributes.Remove(second);
+    ASSERT_EQUAL(attributes.GetAliveCount(), 2u);
+    ASSERT_EQUAL(attributes.GetOrdinalCount(), 3u);
+    ASSERT(!attributes.Contains(3));
+    ASSERT_EQUAL(attributes.FindOrdinal(11), third);
+
+    const vector<DocumentAttributes::Ordinal> ordinals{third, first};
+    vector<int32_t> ratings(ordinals.size());
+    vector<uint8_t> statuses(ordinals.size());
+    attributes.ReadBatch(ordinals, ratings, statuses);
+
+    ASSERT_EQUAL(ratings, (vector<int32_t>{9, 5}));
+    ASSERT(statuses[0] == static_cast<uint8_t>(DocumentStatus::REMOVED));
+    ASSERT(statuses[1] == static_cast<uint8_t>(DocumentStatus::ACTUAL));
+}
+
+void TestStatusPartitionMatchesPredicate()
+{
+    const SearchServer server = GetSearchServerDifferentDocsStatus();
+
+    for (const DocumentStatus doc_status : {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT,
+                                            DocumentStatus::BANNED, DocumentStatus::REMOVED})
+    {
+        const auto by_predicate = server.FindTopDocuments(
+            "cat dog -city"s, [doc_status](int, DocumentStatus status, int)
+            { return status == doc_status; });
+        const auto by_status = server.FindTopDocuments("cat dog -city"s, doc_status);
+        const auto by_status_par = server.FindTopDocuments(execution::par, "cat dog -city"s, doc_status);
+
+        ASSERT_EQUAL(by_status.size(), by_predicate.size());
+        ASSERT_EQUAL(by_status_par.size(), by_predicate.size());
+        for (size_t i = 0; i < by_status.size(); ++i)
+        {
+            ASSERT_EQUAL(by_status[i].id, by_predicate[i].id);
+            ASSERT_EQUAL(by_status_par[i].id, by_predicate[i].id);
+            ASSERT(std::abs(by_status[i].relevance - by_predicate[i].relevance) < 1e-6);
+        }
+    }
+}
+
+void TestDocumentFilters()
+{
+    SearchServer server(""s);
+    for (int id = 0; id < 200; ++id)
+    {
+        const DocumentStatus status = id % 3 == 0 ? DocumentStatus::ACTUAL : DocumentStatus::BANNED;
+        server.AddDocument(id, id % 2 ? "cat city"s : "dog cat"s, status, {id % 10});
+    }
+    server.RemoveDocument(66);
+
+    const auto filter = (filter::Status{DocumentStatus::ACTUAL} && filter::RatingAtLeast{4}) ||
+                        (filter::IdInRange{100, 150} && !filter::EvenId());
+    const auto lambda = [](int document_id, DocumentStatus status, int rating)
+    {
+        return (status == DocumentStatus::ACTUAL && rating >= 4) ||
+               (document_id >= 100 && document_id <= 150 && document_id % 2 != 0);
+    };
+
+    const auto by_filter = server.FindTopDocuments(execution::par, "cat -city"s, filter);
+    const auto by_lambda = server.FindTopDocuments(execution::par, "cat -city"s, lambda);
+    ASSERT_EQUAL(by_filter.size(), by_lambda.size());
+    for (size_t i = 0; i < by_filter.size(); ++i)
+    {
+        ASSERT_EQUAL(by_filter[i].id, by_lambda[i].id);
+    }
+
+    const auto actual_even = server.FindTopDocuments("dog"s, filter::Status{DocumentStatus::ACTUAL} && filter::EvenId());
+    for (const Document &document : actual_even)
+    {
+        ASSERT(document.id % 6 == 0 && document.id != 66);
+    }
+}
+
+void TestScoringKernelsBitIdentical()
+{
+    const vector<string> words{"cat"s, "dog"s, "bird"s, "fish"s, "mouse"s, "horse"s, "cow"s};
+    SearchServer server(""s);
+    for (int id = 0; id < 10'000; ++id)
+    {
+        string text;
+        for (int i = 0; i < 1 + id % 5; ++i)
+        {
+            text += words[(id * 7 + i * 3) % words.size()] + " "s;
+        }
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 7});
+    }
+
+    const ScoringKernel detected = GetScoringKernel();
+    const auto expected = server.FindTopDocuments("cat bird cow -horse"s);
+    for (const ScoringKernel kernel : {ScoringKernel::SCALAR, ScoringKernel::AVX2, ScoringKernel::AVX512})
+    {
+        if (!SetScoringKernel(kernel))
+        {
+            continue;
+        }
+        for (const auto &found : {server.FindTopDocuments("cat bird cow -horse"s),
+                                  server.FindTopDocuments(execution::par, "cat bird cow -horse"s)})
+        {
+            ASSERT_EQUAL(found.size(), expected.size());
+            for (size_t i = 0; i < found.size(); ++i)
+            {
+                ASSERT_EQUAL(found[i].id, expected[i].id);
+                ASSERT(found[i].relevance == expected[i].relevance);
+            }
+        }
+    }
+    SetScoringKernel(detected);
+}
+
+void TestQuantizedTermFreqs()
+{
+    const vector<string> documents{"white cat and fancy collar"s,
+                                   "fluffy cat fluffy tail"s,
+                                   "groomed dog expressive eyes"s,
+                                   "groomed starling evgeny"s,
+                                   "cat cat cat dog"s};
+    const string query = "fluffy groomed cat -collar"s;
+
+    SearchServer exact(""s);
+    for (int id = 0; id < static_cast<int>(documents.size()); ++id)
+    {
+        exact.AddDocument(id, documents[id], DocumentStatus::ACTUAL, {id});
+    }
+    const auto expected = exact.FindTopDocuments(query);
+
+    for (const TermFreqMode mode : {TermFreqMode::QUANTIZED_16, TermFreqMode::QUANTIZED_8})
+    {
+        SearchServerOptions options;
+        options.term_freq_mode = mode;
+        SearchServer quantized(""s, options);
+        for (int id = 0; id < static_cast<int>(documents.size()); ++id)
+        {
+            quantized.AddDocument(id, documents[id], DocumentStatus::ACTUAL, {id});
+        }
+        // каждое слово запроса вносит ошибку не больше idf * шаг квантования
+        const double max_error = 3 * log(static_cast<double>(documents.size())) * GetTermFreqError(mode);
+        const auto found = quantized.FindTopDocuments(query);
+        ASSERT_EQUAL(found.size(), expected.size());
+        for (const Document &document : found)
+        {
+            const auto it = find_if(expected.begin(), expected.end(), [&document](const Document &other)
+                                    { return other.id == document.id; });
+            ASSERT(it != expected.end());
+            ASSERT(abs(it->relevance - document.relevance) <= max_error);
+        }
+    }
+}
+
+void TestCompressedPostingList()
+{
+    using Ordinal = PostingList::Ordinal;
+    mt19937 generator(7);
+    vector<Ordinal> expected;
+    vector<double> expected_freqs;
+    PostingList postings;
+    Ordinal ordinal = 0;
+    for (int i = 0; i < 1000; ++i)
+    {
+        // в основном плотные номера и изредка большие разрывы, которые попадают в исключения
+        ordinal += i % 97 == 0 ? 1'000'000 : uniform_int_distribution<Ordinal>(1, 8)(generator);
+        expected.push_back(ordinal);
+        expected_freqs.push_back(1.0 / (i + 1));
+        postings.Add(ordinal, expected_freqs.back(), TermFreqMode::EXACT);
+    }
+
+    const auto check = [&]()
+    {
+        vector<Ordinal> buffer;
+        const PostingList::View view = postings.GetView(buffer);
+        ASSERT(equal(view.ordinals.begin(), view.ordinals.end(), expected.begin(), expected.end()));
+
+        const Ordinal first = expected[expected.size() / 3] - 1;
+        const Ordinal last = expected[expected.size() * 2 / 3] + 1;
+        const PostingList::View slice = postings.Slice(first, last, buffer);
+        const auto begin = lower_bound(expected.begin(), expected.end(), first);
+        const auto end = lower_bound(expected.begin(), expected.end(), last);
+        ASSERT(equal(slice.ordinals.begin(), slice.ordinals.end(), begin, end));
+        double term_freq;
+        slice.DecodeTermFreqs(0, 1, &term_freq);
+        ASSERT_EQUAL(term_freq, expected_freqs[begin - expected.begin()]);
+
+        ASSERT_EQUAL(postings.size(), expected.size());
+        vector<Ordinal> found;
+        vector<double> found_freqs;
+        postings.Gather(expected, found, found_freqs);
+        ASSERT(found == expected);
+        ASSERT(found_freqs == expected_freqs);
+    };
+    check();
+    ASSERT(postings.GetOrdinalBytes() < expected.size() * sizeof(Ordinal) / 2);
+
+    postings.Remove(expected[10]);
+    expected.erase(expected.begin() + 10);
+    expected_freqs.erase(expected_freqs.begin() + 10);
+    postings.Remove(expected.back());
+    expected.pop_back();
+    expected_freqs.pop_back();
+    postings.Remove(expected.back() + 1);
+    check();
+
+    // удаление пересжимает только свой блок: блоки становятся неполными, а опустевший блок исчезает
+    const Ordinal removed = expected[200];
+    for (int i = 0; i < 140; ++i)
+    {
+        postings.Remove(expected[200]);
+        expected.erase(expected.begin() + 200);
+        expected_freqs.erase(expected_freqs.begin() + 200);
+    }
+    ASSERT(!postings.Contains(removed));
+    ASSERT(postings.Contains(expected[200]));
+    check();
+
+    postings.Add(expected[500] + 1, 0.5, TermFreqMode::EXACT);
+    expected.insert(expected.begin() + 501, expected[500] + 1);
+    expected_freqs.insert(expected_freqs.begin() + 501, 0.5);
+    check();
+
+    bool thrown = false;
+    try
+    {
+        postings.Add(expected[0], 0.5, TermFreqMode::EXACT);
+    }
+    catch (const logic_error &)
+    {
+        thrown = true;
+    }
+    ASSERT(thrown);
+    check();
+}
+
+void TestIndexStats()
+{
+    SearchServer server("and"s);
+    server.AddDocument(1, "white cat and fancy collar"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "groomed dog cat"s, DocumentStatus::BANNED, {3});
+
+    IndexStats stats = server.GetIndexStats(2);
+    ASSERT_EQUAL(stats.document_count, 3u);
+    // white cat fancy collar fluffy tail groomed dog
+    ASSERT_EQUAL(stats.term_count, 8u);
+    ASSERT_EQUAL(stats.posting_count, 10u);
+    ASSERT(abs(stats.average_document_terms - 10.0 / 3) < 1e-9);
+    ASSERT_EQUAL(stats.posting_length_histogram[0], 7u);
+    ASSERT_EQUAL(stats.posting_length_histogram[1], 1u);
+    ASSERT_EQUAL(stats.largest_postings.size(), 2u);
+    ASSERT_EQUAL(stats.largest_postings[0].first, "cat"sv);
+    ASSERT_EQUAL(stats.largest_postings[0].second, 3u);
+    ASSERT(stats.memory.inverted_index > 0 && stats.memory.forward_index > 0 && stats.memory.documents > 0);
+    ASSERT(stats.memory.stop_words > 0);
+    ASSERT(stats.memory.GetTotal() > stats.memory.inverted_index);
+
+    const size_t forward_index = stats.memory.forward_index;
+    server.RemoveDocument(1);
+    stats = server.GetIndexStats();
+    ASSERT_EQUAL(stats.document_count, 2u);
+    ASSERT_EQUAL(stats.term_count, 5u);
+    ASSERT(stats.memory.forward_index < forward_index);
+}
+
+void TestForwardIndex()
+{
+    SearchServer server("and"s);
+    server.AddDocument(1, "white cat and fancy collar"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "groomed dog cat"s, DocumentStatus::BANNED, {3});
+
+    map<string_view, double> frequencies;
+    for (const auto &[word, frequency] : server.GetWordFrequencies(2))
+    {
+        frequencies[word] = frequency;
+    }
+    ASSERT_EQUAL(frequencies.size(), 3u);
+    ASSERT(abs(frequencies["fluffy"sv] - 0.5) < 1e-12);
+    ASSERT(abs(frequencies["tail"sv] - 0.25) < 1e-12);
+    ASSERT(server.GetWordFrequencies(100).empty());
+
+    // копия сервера не ссылается на строки исходного
+    SearchServer copy = server;
+    {
+        SearchServer moved_from = server;
+        copy = moved_from;
+    }
+    ASSERT_EQUAL(copy.FindTopDocuments("fluffy"s).front().id, 2);
+    ASSERT_EQUAL(get<0>(copy.MatchDocument("cat collar"s, 1)), (vector<string_view>{"cat"sv, "collar"sv}));
+
+    // удаление уплотняет прямой индекс, слова оставшихся документов не меняются
+    server.RemoveDocument(1);
+    server.RemoveDocument(3);
+    ASSERT(server.GetWordFrequencies(1).empty());
+    ASSERT_EQUAL(server.GetWordFrequencies(2).size(), 3u);
+    ASSERT_EQUAL(get<0>(server.MatchDocument("tail fluffy dog"s, 2)), (vector<string_view>{"fluffy"sv, "tail"sv}));
+}
+
+void TestWithoutForwardIndex()
+{
+    SearchServerOptions options;
+    options.forward_index_mode = ForwardIndexMode::NONE;
+    SearchServer server("and with"s, options);
+    SearchServer reference("and with"s);
+    for (int id = 1; id <= 12; ++id)
+    {
+        const string text = (id % 2 == 0 ? "fluffy cat"s : "groomed dog"s) + " collar"s + to_string(id % 3);
+        server.AddDocument(id, text, id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {id});
+        reference.AddDocument(id, text, id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {id});
+    }
+    // вместо прямого индекса хранятся только номера слов
+    ASSERT(server.GetIndexStats().memory.forward_index < reference.GetIndexStats().memory.forward_index);
+
+    bool thrown = false;
+    try
+    {
+        server.MatchDocument("cat"s, 2);
+    }
+    catch (const logic_error &)
+    {
+        thrown = true;
+    }
+    ASSERT(thrown);
+
+    // удалённый документ остаётся надгробием и не попадает в выдачу
+    server.RemoveDocument(2);
+    ASSERT_EQUAL(server.GetTombstoneCount(), 1u);
+    ASSERT_EQUAL(server.GetDocumentCount(), 11);
+    for (const Document &document : server.FindTopDocuments("fluffy cat collar2"s))
+    {
+        ASSERT(document.id != 2);
+    }
+    for (const Document &document : server.FindTopDocuments("cat"s, [](int, DocumentStatus, int)
+                                                            { return true; }))
+    {
+        ASSERT(document.id != 2);
+    }
+    ASSERT(server.FindTopDocuments("cat"s, filter::IdInRange{2, 2}).empty());
+
+    // после очистки результаты совпадают с сервером, который удалял документы сразу
+    server.RemoveDocument(execution::par, 4);
+    reference.RemoveDocument(2);
+    reference.RemoveDocument(4);
+    server.PurgeRemovedDocuments();
+    ASSERT_EQUAL(server.GetTombstoneCount(), 0u);
+    ASSERT_EQUAL(server.GetIndexStats().posting_count, reference.GetIndexStats().posting_count);
+    for (const string &query : {"fluffy cat"s, "dog -collar1"s, "collar0 collar2"s})
+    {
+        const auto expected = reference.FindTopDocuments(query);
+        const auto result = server.FindTopDocuments(query);
+        ASSERT_EQUAL(result.size(), expected.size());
+        for (size_t i = 0; i < result.size(); ++i)
+        {
+            ASSERT_EQUAL(result[i].id, expected[i].id);
+            ASSERT(abs(result[i].relevance - expected[i].relevance) < 1e-12);
+        }
+    }
+
+    // надгробия вычищаются сами, когда их становится много
+    for (int id = 5; id <= 7; ++id)
+    {
+        server.RemoveDocument(id);
+    }
+    ASSERT(server.GetTombstoneCount() < 3u);
+}
+
+void TestTombstonesExcludedFromInverseDocumentFreq()
+{
+    SearchServerOptions options;
+    options.forward_index_mode = ForwardIndexMode::NONE;
+    SearchServer server(""s, options);
+    SearchServer reference(""s);
+    for (int id = 1; id <= 10; ++id)
+    {
+        // cat есть почти во всех документах: с надгробиями в частоте документа его IDF стал бы отрицательным
+        const string text = (id == 10 ? "dog"s : "cat"s) + (id % 2 == 0 ? " fluffy"s : " groomed"s);
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+        reference.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+    }
+    server.RemoveDocument(2);
+    server.RemoveDocument(3);
+    reference.RemoveDocument(2);
+    reference.RemoveDocument(3);
+    ASSERT_EQUAL(server.GetTombstoneCount(), 2u);
+
+    const auto expected = reference.FindTopDocuments("cat fluffy"s);
+    const auto result = server.FindTopDocuments("cat fluffy"s);
+    ASSERT_EQUAL(result.size(), expected.size());
+    for (size_t i = 0; i < result.size(); ++i)
+    {
+        ASSERT_EQUAL(result[i].id, expected[i].id);
+        ASSERT(abs(result[i].relevance - expected[i].relevance) < 1e-12);
+        ASSERT(result[i].relevance > 0);
+    }
+}
+
+void TestRemoveWithoutForwardIndexTouchesDocumentTermsOnly()
+{
+    // у каждого документа своё слово: удаление, перебирающее словарь, стоило бы порядка 100000 проверок
+    constexpr int document_count = 100000;
+    constexpr int removed_count = 3000;
+    SearchServerOptions options;
+    options.forward_index_mode = ForwardIndexMode::NONE;
+    SearchServer server(""s, options);
+    SearchServer reference(""s);
+    for (int id = 0; id < document_count; ++id)
+    {
+        const string text = "word"s + to_string(id) + " group"s + to_string(id % 10);
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 7});
+        reference.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 7});
+    }
+    const auto remove_all = [](SearchServer &target)
+    {
+        const auto start = chrono::steady_clock::now();
+        for (int id = 0; id < removed_count; ++id)
+        {
+            target.RemoveDocument(id * 3);
+        }
+        return chrono::steady_clock::now() - start;
+    };
+    const auto reference_elapsed = remove_all(reference);
+    const auto elapsed = remove_all(server);
+    ASSERT_EQUAL(server.GetTombstoneCount(), static_cast<size_t>(removed_count));
+    // удаление надгробием не должно стоить заметно дороже удаления через прямой индекс
+    ASSERT(elapsed < reference_elapsed * 10 + chrono::milliseconds{50});
+
+    const auto expected = reference.FindTopDocuments("group3 word4"s);
+    const auto result = server.FindTopDocuments("group3 word4"s);
+    ASSERT_EQUAL(result.size(), expected.size());
+    for (size_t i = 0; i < result.size(); ++i)
+    {
+        ASSERT_EQUAL(result[i].id, expected[i].id);
+        ASSERT(abs(result[i].relevance - expected[i].relevance) < 1e-12);
+    }
+}
+
+void TestPhraseQueries()
+{
+    SearchServerOptions options;
+    options.store_positions = true;
+    options.result_cache_capacity = 8;
+    SearchServer server("and the"s, options);
+    server.AddDocument(1, "funny pet with a collar"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "pet funny"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "funny and the pet"s, DocumentStatus::ACTUAL, {3});
+    server.AddDocument(4, "funny old pet and funny pet"s, DocumentStatus::ACTUAL, {4});
+    ASSERT(server.GetIndexStats().memory.positions > 0);
+
+    const auto ids = [](const vector<Document> &documents)
+    {
+        vector<int> result;
+        for (const Document &document : documents)
+        {
+            result.push_back(document.id);
+        }
+        sort(result.begin(), result.end());
+        return result;
+    };
+
+    ASSERT_EQUAL(ids(server.FindTopDocuments("\"funny pet\""s)), (vector<int>{1, 4}));
+    // стоп-слова занимают место и во фразе, и в документе
+    ASSERT_EQUAL(ids(server.FindTopDocuments("\"funny and the pet\""s)), (vector<int>{3}));
+    ASSERT_EQUAL(ids(server.FindTopDocuments("\"funny pet\"~2"s)), (vector<int>{1, 3, 4}));
+    ASSERT_EQUAL(ids(server.FindTopDocuments("\"pet funny\"~3"s)), (vector<int>{2, 4}));
+    ASSERT_EQUAL(ids(server.FindTopDocuments("\"funny pet\" -collar"s)), (vector<int>{4}));
+    ASSERT(server.FindTopDocuments("\"funny cat\""s).empty());
+    // повтор запроса из кэша не должен потерять фразу
+    ASSERT_EQUAL(ids(server.FindTopDocuments("\"funny pet\""s)), (vector<int>{1, 4}));
+    ASSERT_EQUAL(ids(server.FindTopDocumentsBatch(vector<string>{"\"funny pet\"~2"s})[0]), (vector<int>{1, 3, 4}));
+
+    server.RemoveDocument(1);
+    ASSERT_EQUAL(ids(server.FindTopDocuments(execution::par, "\"funny pet\""s)), (vector<int>{4}));
+
+    // незакрытая кавычка, минус-слово внутри фразы и нечисловое расстояние
+    for (const string_view query : {"\"funny pet"sv, "\"funny -pet\""sv, "\"funny pet\"~x"sv})
+    {
+        string exString{};
+        try
+        {
+            server.FindTopDocuments(query);
+        }
+        catch (const invalid_argument &e)
+        {
+            exString = e.what();
+        }
+        ASSERT(!exString.empty());
+    }
+
+    // без позиций фразу проверить нечем
+    SearchServer without_positions("and"s);
+    without_positions.AddDocument(1, "funny pet"s, DocumentStatus::ACTUAL, {1});
+    bool thrown = false;
+    try
+    {
+        without_positions.FindTopDocuments("\"funny pet\""s);
+    }
+    catch (const logic_error &)
+    {
+        thrown = true;
+    }
+    ASSERT(thrown);
+}
+
+void TestPrefixQueries()
+{
+    SearchServerOptions options;
+    options.max_prefix_expansions = 2;
+    SearchServer server("and"s, options);
+    server.AddDocument(1, "pet shop"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "petal and petunia"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "petal garden"s, DocumentStatus::ACTUAL, {3});
+    server.AddDocument(4, "peter pan"s, DocumentStatus::ACTUAL, {4});
+    server.AddDocument(5, "pets petal"s, DocumentStatus::ACTUAL, {5});
+    // слова добавляются после слияния хвоста словаря, чтобы проверить обе его части
+    for (int id = 6; id < 100; ++id)
+    {
+        server.AddDocument(id, "word"s + to_string(id), DocumentStatus::ACTUAL, {id});
+    }
+    server.AddDocument(100, "petri dish"s, DocumentStatus::ACTUAL, {100});
+
+    // самое частое слово petal и затем первое по номеру среди встречающихся в одном документе
+    vector<int> ids;
+    for (const Document &document : server.FindTopDocuments("pet*"s))
+    {
+        ids.push_back(document.id);
+    }
+    sort(ids.begin(), ids.end());
+    ASSERT_EQUAL(ids, (vector<int>{1, 2, 3, 5}));
+
+    ASSERT_EQUAL(server.FindTopDocuments("petr*"s).size(), 1u);
+    ASSERT_EQUAL(server.FindTopDocuments("petr*"s)[0].id, 100);
+    ASSERT(server.FindTopDocuments("cat*"s).empty());
+
+    // минус-префикс раскрывается без ограничения
+    ASSERT_EQUAL(server.FindTopDocuments("shop garden pan dish -pet*"s).size(), 0u);
+    const auto [words, status] = server.MatchDocument("garden peta*"s, 3);
+    ASSERT_EQUAL(words, (vector<string_view>{"garden"sv, "petal"sv}));
+
+    const auto is_rejected = [&server](const string &query)
+    {
+        try
+        {
+            server.FindTopDocuments(query);
+        }
+        catch (const invalid_argument &)
+        {
+            return true;
+        }
+        return false;
+    };
+    ASSERT(is_rejected("*"s));
+    ASSERT(is_rejected("-*"s));
+    // префиксы внутри фразы не раскрываются
+    ASSERT(is_rejected("\"pet* shop\""s));
+}
+
+void TestFuzzyQueries()
+{
+    SearchServerOptions options;
+    options.max_fuzzy_distance = 2;
+    SearchServer server("and"s, options);
+    SearchServer exact("and"s);
+    for (SearchServer *target : {&server, &exact})
+    {
+        target->AddDocument(1, "fluffy cat"s, DocumentStatus::ACTUAL, {1});
+        target->AddDocument(2, "groomed dog"s, DocumentStatus::ACTUAL, {2});
+        target->AddDocument(3, "fluffy tail and fluffy ears"s, DocumentStatus::ACTUAL, {3});
+        target->AddDocument(4, "dog collar"s, DocumentStatus::ACTUAL, {4});
+    }
+    ASSERT(server.GetIndexStats().memory.fuzzy_terms > exact.GetIndexStats().memory.fuzzy_terms);
+
+    // поиск с опечаткой включается только когда точный запрос ничего не нашёл
+    ASSERT(exact.FindTopDocuments("flufy"s).empty());
+    const auto expected = server.FindTopDocuments("fluffy"s);
+    const auto result = server.FindTopDocuments("flufy"s);
+    ASSERT_EQUAL(result.size(), expected.size());
+    for (size_t i = 0; i < result.size(); ++i)
+    {
+        ASSERT_EQUAL(result[i].id, expected[i].id);
+        ASSERT(abs(result[i].relevance - expected[i].relevance * options.fuzzy_distance_penalty) < 1e-12);
+    }
+    ASSERT_EQUAL(server.FindTopDocuments(execution::par, "flufy"s).size(), result.size());
+    ASSERT_EQUAL(server.FindTopDocumentsBatch(vector<string>{"flufy"s})[0].size(), result.size());
+
+    ASSERT_EQUAL(server.FindTopDocuments("flufy -cat"s).size(), 1u);
+    ASSERT_EQUAL(server.FindTopDocuments("flufy -cat"s)[0].id, 3);
+    ASSERT_EQUAL(server.FindTopDocuments("groomedd collr"s).size(), 2u);
+    // у слова из 3-5 букв допускается одна правка, у более короткого - ни одной
+    ASSERT(server.FindTopDocuments("dgo"s).empty());
+    ASSERT_EQUAL(server.FindTopDocuments("dogg"s).size(), 2u);
+    ASSERT(server.FindTopDocuments("ct"s).empty());
+}
+
+void TestSearchPages()
+{
+    SearchServer server("and"s);
+    for (int id = 1; id <= 50; ++id)
+    {
+        // равные релевантность и рейтинг у части документов проверяют порядок по id на границах страниц
+        server.AddDocument(id, "cat dog"s + (id % 3 == 0 ? " cat"s : ""s) + (id % 5 == 0 ? " bird"s : ""s), DocumentStatus::ACTUAL, {id % 4});
+    }
+    server.AddDocument(51, "cat"s, DocumentStatus::BANNED, {1});
+
+    // полная выдача: окно больше числа документов
+    PageRequest all;
+    all.limit = 100;
+    const SearchPage full = server.FindTopDocumentsPage("cat dog"s, all);
+    ASSERT_EQUAL(full.documents.size(), 50u);
+    ASSERT(!full.next);
+    const auto top = server.FindTopDocuments("cat dog"s);
+    for (size_t i = 0; i < top.size(); ++i)
+    {
+        ASSERT_EQUAL(full.documents[i].id, top[i].id);
+    }
+
+    // по курсору страницы складываются в ту же выдачу
+    vector<int> paged;
+    PageRequest request;
+    request.limit = 7;
+    size_t page_count = 0;
+    for (;; ++page_count)
+    {
+        const SearchPage page = server.FindTopDocumentsPage("cat dog"s, request);
+        for (const Document &document : page.documents)
+        {
+            paged.push_back(document.id);
+        }
+        if (!page.next)
+        {
+            break;
+        }
+        request.after = DecodeCursor(EncodeCursor(*page.next));
+    }
+    ASSERT_EQUAL(page_count, 7u);
+    ASSERT_EQUAL(paged.size(), full.documents.size());
+    for (size_t i = 0; i < paged.size(); ++i)
+    {
+        ASSERT_EQUAL(paged[i], full.documents[i].id);
+    }
+
+    // смещение от начала и смещение после курсора
+    PageRequest offset;
+    offset.offset = 10;
+    offset.limit = 5;
+    const SearchPage by_offset = server.FindTopDocumentsPage(execution::par, "cat dog"s, offset, DocumentStatus::ACTUAL);
+    ASSERT_EQUAL(by_offset.documents.size(), 5u);
+    ASSERT_EQUAL(by_offset.documents.front().id, full.documents[10].id);
+    ASSERT_EQUAL(by_offset.next->id, full.documents[14].id);
+    offset.after = SearchCursor{full.documents[4].relevance, full.documents[4].rating, full.documents[4].id};
+    offset.offset = 5;
+    ASSERT_EQUAL(server.FindTopDocumentsPage("cat dog"s, offset).documents.front().id, full.documents[10].id);
+
+    const SearchPage banned = server.FindTopDocumentsPage(execution::seq, "cat"s, all, [](int, DocumentStatus status, int)
+                                                          { return status == DocumentStatus::BANNED; });
+    ASSERT_EQUAL(banned.documents.size(), 1u);
+    ASSERT_EQUAL(banned.documents[0].id, 51);
+
+    // пустая страница не даёт курсора, по которому можно продолжить
+    PageRequest empty_page;
+    empty_page.limit = 0;
+    string exString{};
+    try
+    {
+        server.FindTopDocumentsPage("cat dog"s, empty_page);
+    }
+    catch (const invalid_argument &e)
+    {
+        exString = e.what();
+    }
+    ASSERT(!exString.empty());
+
+    bool thrown = false;
+    try
+    {
+        DecodeCursor("12:x:3"s);
+    }
+    catch (const invalid_argument &)
+    {
+        thrown = true;
+    }
+    ASSERT(thrown);
+}
+
+void TestBooleanQueries()
+{
+    SearchServer server("and"s);
+    server.AddDocument(1, "white cat fancy collar"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::ACTUAL, {3});
+    server.AddDocument(4, "groomed cat white collar"s, DocumentStatus::ACTUAL, {4});
+    server.AddDocument(5, "dog collar"s, DocumentStatus::ACTUAL, {5});
+
+    const auto ids = [&server](const string &query)
+    {
+        vector<int> result;
+        for (const Document &document : server.FindTopDocuments(query))
+        {
+            result.push_back(document.id);
+        }
+        sort(result.begin(), result.end());
+        return result;
+    };
+
+    ASSERT_EQUAL(ids("+cat +collar"s), (vector<int>{1, 4}));
+    ASSERT_EQUAL(ids("cat AND collar"s), (vector<int>{1, 4}));
+    ASSERT_EQUAL(ids("cat AND NOT white"s), (vector<int>{2}));
+    ASSERT_EQUAL(ids("(cat OR dog) AND collar"s), (vector<int>{1, 4, 5}));
+    ASSERT_EQUAL(ids("+collar fluffy"s), (vector<int>{1, 4, 5}));
+    ASSERT_EQUAL(ids("groomed AND (dog OR white) -eyes"s), (vector<int>{4}));
+    ASSERT_EQUAL(ids("collar -(white OR fancy)"s), (vector<int>{5}));
+    ASSERT(ids("+cat +parrot"s).empty());
+    ASSERT(ids("NOT cat"s).empty());
+
+    // релевантность считается по тем же словам, что и без операторов
+    const auto plain = server.FindTopDocuments("cat collar"s);
+    const auto required = server.FindTopDocuments("+cat +collar"s);
+    for (const Document &document : required)
+    {
+        const auto same = find_if(plain.begin(), plain.end(), [&document](const Document &other)
+                                  { return other.id == document.id; });
+        ASSERT(same != plain.end());
+        ASSERT(abs(same->relevance - document.relevance) < 1e-12);
+    }
+    ASSERT_EQUAL(server.FindTopDocuments(execution::par, "(cat OR dog) AND collar"s).size(), 3u);
+    ASSERT_EQUAL(server.FindTopDocumentsBatch(vector<string>{"cat AND NOT white"s, "cat"s})[0].size(), 1u);
+
+    ASSERT(get<0>(server.MatchDocument("cat AND NOT white"s, 1)).empty());
+    ASSERT_EQUAL(get<0>(server.MatchDocument("cat AND NOT white"s, 2)), (vector<string_view>{"cat"sv}));
+    ASSERT(get<0>(server.MatchDocument("+cat +collar"s, 2)).empty());
+
+    const auto error = [&server](const string &query)
+    {
+        string exString{};
+        try
+        {
+            server.FindTopDocuments(query);
+        }
+        catch (const invalid_argument &e)
+        {
+            exString = e.what();
+        }
+        return exString;
+    };
+    ASSERT(!error("cat AND"s).empty());
+    ASSERT(!error("OR cat"s).empty());
+    ASSERT(!error("NOT NOT cat"s).empty());
+    ASSERT(!error("(cat OR dog"s).empty());
+    ASSERT(!error("cat OR dog)"s).empty());
+    ASSERT(!error("\"fluffy cat\" AND tail"s).empty());
+    ASSERT(!error("++cat"s).empty());
+
+    // скобки внутри слова и стоп-слово AND не делают запрос логическим
+    SearchServer literal("AND"s);
+    literal.AddDocument(1, "happy smile:) (c) author"s, DocumentStatus::ACTUAL, {1});
+    literal.AddDocument(2, "happy cat"s, DocumentStatus::ACTUAL, {2});
+    ASSERT_EQUAL(literal.FindTopDocuments("smile:) dog"s).size(), 1u);
+    ASSERT_EQUAL(literal.FindTopDocuments("(c)"s).size(), 1u);
+    ASSERT_EQUAL(literal.FindTopDocuments("cat AND author"s).size(), 2u);
+
+    // длинные списки: пересечение пропускает блоки, не распаковывая их
+    SearchServer large("and"s);
+    size_t expected = 0;
+    for (int id = 0; id < 3000; ++id)
+    {
+        string text = "common"s;
+        if (id % 97 == 0)
+        {
+            text += " rare"s;
+        }
+        if (id % 5 == 0)
+        {
+            text += " frequent"s;
+        }
+        if (id % 97 == 0 && id % 5 == 0 && id % 2 == 0)
+        {
+            ++expected;
+        }
+        large.AddDocument(id, text, id % 2 == 0 ? DocumentStatus::ACTUAL : DocumentStatus::BANNED, {1});
+    }
+    const auto all = [](int, DocumentStatus status, int)
+    { return status == DocumentStatus::ACTUAL; };
+    PageRequest page;
+    page.limit = 100;
+    ASSERT_EQUAL(large.FindTopDocumentsPage(execution::seq, "+frequent +rare +common"s, page, all).documents.size(), expected);
+    ASSERT_EQUAL(large.FindTopDocumentsPage("rare AND NOT frequent"s, page).documents.size(), 16u - expected);
+}
+
+void TestRatingRangeFilter()
+{
+    SearchServer server(""s);
+    for (int id = 0; id < 2000; ++id)
+    {
+        const DocumentStatus status = id % 4 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        server.AddDocument(id, id % 3 ? "cat city"s : "dog cat"s, status, {id % 100});
+    }
+    for (int id = 0; id < 2000; id += 7)
+    {
+        server.RemoveDocument(id);
+    }
+    // добавленные после удалений документы остаются в хвосте индекса рейтингов
+    server.AddDocument(5000, "cat"s, DocumentStatus::ACTUAL, {97});
+
+    const auto check = [&server](const string &query, const auto &document_filter, const auto &lambda)
+    {
+        const auto by_filter = server.FindTopDocuments(query, document_filter);
+        const auto by_filter_par = server.FindTopDocuments(execution::par, query, document_filter);
+        const auto by_lambda = server.FindTopDocuments(query, lambda);
+        ASSERT_EQUAL(by_filter.size(), by_lambda.size());
+        ASSERT_EQUAL(by_filter_par.size(), by_lambda.size());
+        for (size_t i = 0; i < by_filter.size(); ++i)
+        {
+            ASSERT_EQUAL(by_filter[i].id, by_lambda[i].id);
+            ASSERT_EQUAL(by_filter_par[i].id, by_lambda[i].id);
+            ASSERT(std::abs(by_filter[i].relevance - by_lambda[i].relevance) < 1e-6);
+        }
+    };
+
+    // избирательный фильтр читает индекс рейтингов, широкий - вычисляется по всем документам
+    check("cat -city"s, filter::RatingInRange{95, 98}, [](int, DocumentStatus, int rating)
+          { return rating >= 95 && rating <= 98; });
+    check("cat"s, filter::RatingAtLeast{99}, [](int, DocumentStatus, int rating)
+          { return rating >= 99; });
+    check("cat"s, filter::RatingAtLeast{10}, [](int, DocumentStatus, int rating)
+          { return rating >= 10; });
+    check("dog"s, filter::Status{DocumentStatus::BANNED} && filter::RatingInRange{90, 99}, [](int, DocumentStatus status, int rating)
+          { return status == DocumentStatus::BANNED && rating >= 90; });
+    check("cat"s, filter::RatingInRange{1, 2} || filter::RatingInRange{97, 97}, [](int, DocumentStatus, int rating)
+          { return rating == 1 || rating == 2 || rating == 97; });
+    check("+cat -dog"s, filter::RatingInRange{96, 99} && filter::EvenId(), [](int document_id, DocumentStatus, int rating)
+          { return rating >= 96 && document_id % 2 == 0; });
+    ASSERT(server.FindTopDocuments("cat"s, filter::RatingInRange{10, 5}).empty());
+
+    const auto newest = server.FindTopDocuments("cat"s, filter::RatingInRange{97, 97} && filter::IdInRange{5000, 5000});
+    ASSERT_EQUAL(newest.size(), 1u);
+    ASSERT_EQUAL(newest[0].id, 5000);
+}
+
+void TestDocumentSet()
+{
+    mt19937 generator(7);
+    const auto to_vector = [](const auto &values)
+    {
+        return vector<uint32_t>(values.begin(), values.end());
+    };
+
+    // разреженный блок, плотный блок, длинная последовательность и значения у границ блоков
+    set<uint32_t> expected;
+    DocumentSet values;
+    const auto add = [&](uint32_t value)
+    {
+        ASSERT_EQUAL(values.Add(value), expected.insert(value).second);
+    };
+    for (int i = 0; i < 300; ++i)
+    {
+        add(uniform_int_distribution<uint32_t>(0, 65535)(generator));
+    }
+    for (int i = 0; i < 20000; ++i)
+    {
+        add(65536 + uniform_int_distribution<uint32_t>(0, 30000)(generator));
+    }
+    for (uint32_t value = 3 * 65536 - 100; value < 3 * 65536 + 10000; ++value)
+    {
+        add(value);
+    }
+    add(UINT32_MAX);
+    ASSERT_EQUAL(values.size(), expected.size());
+    ASSERT(to_vector(values) == to_vector(expected));
+
+    const size_t before_optimize = values.GetMemoryUsage();
+    values.RunOptimize();
+    ASSERT(values.GetMemoryUsage() < before_optimize);
+    ASSERT(to_vector(values) == to_vector(expected));
+
+    for (int i = 0; i < 5000; ++i)
+    {
+        const uint32_t value = uniform_int_distribution<uint32_t>(0, 4 * 65536)(generator);
+        ASSERT_EQUAL(values.Contains(value), expected.count(value) > 0);
+        ASSERT_EQUAL(values.Remove(value), expected.erase(value) > 0);
+    }
+    // удаление из середины интервала разрезает его
+    for (uint32_t value = 3 * 65536 + 1000; value < 3 * 65536 + 1010; value += 2)
+    {
+        values.Remove(value);
+        expected.erase(value);
+    }
+    ASSERT_EQUAL(values.size(), expected.size());
+    ASSERT(to_vector(values) == to_vector(expected));
+
+    set<uint32_t> other_expected;
+    for (int i = 0; i < 30000; ++i)
+    {
+        other_expected.insert(uniform_int_distribution<uint32_t>(0, 4 * 65536)(generator));
+    }
+    const vector<uint32_t> other_values = to_vector(other_expected);
+    const DocumentSet other = DocumentSet::FromSorted(other_values);
+
+    vector<uint32_t> both;
+    vector<uint32_t> any;
+    vector<uint32_t> only;
+    set_intersection(expected.begin(), expected.end(), other_expected.begin(), other_expected.end(), back_inserter(both));
+    set_union(expected.begin(), expected.end(), other_expected.begin(), other_expected.end(), back_inserter(any));
+    set_difference(expected.begin(), expected.end(), other_expected.begin(), other_expected.end(), back_inserter(only));
+
+    const DocumentSet and_result = values & other;
+    const DocumentSet or_result = values | other;
+    const DocumentSet and_not_result = values - other;
+    ASSERT(to_vector(and_result) == both);
+    ASSERT_EQUAL(and_result.size(), both.size());
+    ASSERT(to_vector(or_result) == any);
+    ASSERT_EQUAL(or_result.size(), any.size());
+    ASSERT(to_vector(and_not_result) == only);
+    ASSERT_EQUAL(and_not_result.size(), only.size());
+    ASSERT((values - values).empty());
+
+    vector<size_t> found;
+    values.IntersectSorted(other_values, [&found](size_t i)
+                           { found.push_back(i); });
+    ASSERT_EQUAL(found.size(), both.size());
+    for (size_t i = 0; i < found.size(); ++i)
+    {
+        ASSERT_EQUAL(other_values[found[i]], both[i]);
+    }
+
+    SearchServer server(""s);
+    for (int id = 0; id < 20000; ++id)
+    {
+        server.AddDocument(id, "cat"s, DocumentStatus::ACTUAL, {1});
+    }
+    server.RemoveDocument(500);
+    vector<int> ids(server.begin(), server.end());
+    ASSERT_EQUAL(ids.size(), 19999u);
+    ASSERT_EQUAL(ids[499], 499);
+    ASSERT_EQUAL(ids[500], 501);
+
+    // подряд выданные id хранятся интервалами
+    DocumentSet sequential;
+    for (uint32_t id = 0; id < 20000; ++id)
+    {
+        sequential.Add(id);
+    }
+    ASSERT(sequential.GetMemoryUsage() < 1024);
+}
+
+void TestResultCache()
+{
+    SearchServerOptions options;
+    options.result_cache_capacity = 32;
+    SearchServer server("and"s, options);
+    server.AddDocument(1, "white cat and fancy collar"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {2});
+
+    const auto first = server.FindTopDocuments("fluffy cat"s);
+    // тот же запрос после нормализации: порядок, повторы и стоп-слова не важны
+    const auto second = server.FindTopDocuments(execution::par, "cat and fluffy cat"s);
+    ASSERT_EQUAL(first.size(), second.size());
+    ASSERT_EQUAL(first[0].id, second[0].id);
+    ResultCacheStats stats = server.GetResultCacheStats();
+    ASSERT_EQUAL(stats.hits, 1u);
+    ASSERT_EQUAL(stats.misses, 1u);
+
+    // другой статус - другой ключ, предикат кэш не использует
+    ASSERT(server.FindTopDocuments("fluffy cat"s, DocumentStatus::BANNED).empty());
+    server.FindTopDocuments("fluffy cat"s, [](int, DocumentStatus, int)
+                            { return true; });
+    stats = server.GetResultCacheStats();
+    ASSERT_EQUAL(stats.hits, 1u);
+    ASSERT_EQUAL(stats.misses, 2u);
+
+    server.AddDocument(3, "fluffy fluffy cat"s, DocumentStatus::ACTUAL, {3});
+    ASSERT_EQUAL(server.FindTopDocuments("fluffy cat"s)[0].id, 3);
+    server.RemoveDocument(3);
+    ASSERT_EQUAL(server.FindTopDocuments("fluffy cat"s)[0].id, 2);
+    stats = server.GetResultCacheStats();
+    ASSERT_EQUAL(stats.hits, 1u);
+
+    for (int i = 0; i < 200; ++i)
+    {
+        server.FindTopDocuments("cat "s + to_string(i));
+    }
+    ASSERT(server.GetResultCacheStats().size <= options.result_cache_capacity);
+}
+
+void TestLatencyHistogram()
+{
+    LatencyHistogram histogram;
+    for (int i = 1; i <= 1000; ++i)
+    {
+        histogram.Record(chrono::microseconds{i});
+    }
+    ASSERT_EQUAL(histogram.GetCount(), 1000u);
+    ASSERT_EQUAL(histogram.GetMax().count(), 1'000'000);
+    // корзины дают относительную ошибку не больше 1/16
+    for (const double quantile : {0.5, 0.9, 0.99})
+    {
+        const double expected = quantile * 1'000'000;
+        const double found = static_cast<double>(histogram.GetPercentile(quantile).count());
+        ASSERT(abs(found - expected) <= expected / LatencyHistogram::SUB_BUCKET_COUNT);
+    }
+
+    const uint64_t recorded = GetLatencyHistogram(LatencyStage::QUERY_SORT).GetCount();
+    vector<thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([]()
+                             {
+                                 for (int i = 0; i < 100; ++i)
+                                 {
+                                     RecordLatency(LatencyStage::QUERY_SORT, chrono::nanoseconds{i});
+                                 } });
+    }
+    for (thread &th : threads)
+    {
+        th.join();
+    }
+    // гистограммы завершившихся потоков сохраняются
+    ASSERT_EQUAL(GetLatencyHistogram(LatencyStage::QUERY_SORT).GetCount(), recorded + 400);
+}
+
+void TestBatchMatchesSingleQueries()
+{
+    const vector<string> words{"cat"s, "dog"s, "bird"s, "fish"s, "mouse"s, "horse"s, "cow"s, "owl"s, "fox"s};
+    mt19937 generator(11);
+    SearchServer server("owl"s);
+    for (int id = 0; id < 3'000; ++id)
+    {
+        string text;
+        const int word_count = uniform_int_distribution(1, 8)(generator);
+        for (int i = 0; i < word_count; ++i)
+        {
+            text += words[uniform_int_distribution<size_t>(0, words.size() - 1)(generator)] + " "s;
+        }
+        server.AddDocument(id, text, static_cast<DocumentStatus>(id % 3), {id % 11});
+    }
+
+    vector<string> queries;
+    for (int i = 0; i < 500; ++i)
+    {
+        string query;
+        const int word_count = uniform_int_distribution(1, 4)(generator);
+        for (int j = 0; j < word_count; ++j)
+        {
+            query += (j > 0 ? " "s : ""s) + (uniform_int_distribution(0, 4)(generator) == 0 ? "-"s : ""s) +
+                     words[uniform_int_distribution<size_t>(0, words.size() - 1)(generator)];
+        }
+        queries.push_back(query);
+    }
+
+    for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED})
+    {
+        const auto batch = server.FindTopDocumentsBatch(queries, status);
+        ASSERT_EQUAL(batch.size(), queries.size());
+        for (size_t i = 0; i < queries.size(); ++i)
+        {
+            const auto expected = server.FindTopDocuments(queries[i], status);
+            ASSERT_EQUAL(batch[i].size(), expected.size());
+            for (size_t j = 0; j < expected.size(); ++j)
+            {
+                ASSERT_EQUAL(batch[i][j].id, expected[j].id);
+                ASSERT(batch[i][j].relevance == expected[j].relevance);
+            }
+        }
+    }
+}
+
 void TestAll1()
 {
     TestRunner tr;
@@ -700,11 +2061,38 @@ void TestAll1()
     RUN_TEST(tr, TestPaginator);
 
     RUN_TEST(tr, TestRequestQueue);
+    RUN_TEST(tr, TestRequestQueueSharedByThreads);
 
     RUN_TEST(tr, TestRemoveDuplicates);
 
     RUN_TEST(tr, TestProcessQueries);
     RUN_TEST(tr, TestProcessQueriesJoined);
+    RUN_TEST(tr, TestProcessQueriesStreaming);
+    RUN_TEST(tr, TestMatchDocuments);
+    RUN_TEST(tr, TestAsyncQueries);
+    RUN_TEST(tr, TestExecutorPolicy);
+
+    RUN_TEST(tr, TestDocumentAttributes);
+    RUN_TEST(tr, TestStatusPartitionMatchesPredicate);
+    RUN_TEST(tr, TestDocumentFilters);
+    RUN_TEST(tr, TestScoringKernelsBitIdentical);
+    RUN_TEST(tr, TestQuantizedTermFreqs);
+    RUN_TEST(tr, TestCompressedPostingList);
+    RUN_TEST(tr, TestIndexStats);
+    RUN_TEST(tr, TestForwardIndex);
+    RUN_TEST(tr, TestWithoutForwardIndex);
+    RUN_TEST(tr, TestTombstonesExcludedFromInverseDocumentFreq);
+    RUN_TEST(tr, TestRemoveWithoutForwardIndexTouchesDocumentTermsOnly);
+    RUN_TEST(tr, TestPhraseQueries);
+    RUN_TEST(tr, TestPrefixQueries);
+    RUN_TEST(tr, TestFuzzyQueries);
+    RUN_TEST(tr, TestSearchPages);
+    RUN_TEST(tr, TestBooleanQueries);
+    RUN_TEST(tr, TestRatingRangeFilter);
+    RUN_TEST(tr, TestDocumentSet);
+    RUN_TEST(tr, TestResultCache);
+    RUN_TEST(tr, TestLatencyHistogram);
+    RUN_TEST(tr, TestBatchMatchesSingleQueries);
 }
 
 ////////////////////////////////////////////////////////////////////////////